@@ -1,34 +1,125 @@
 #pragma once
 
+#include <cstddef>
 #include <forward_list>
+#include <limits>
+#include <new>
 #include <vector>
 
 // a simple one-type arena allocator built using STL containers.
 // Arena allocation often has big performance benefits in tree code.
+//
+// reset() keeps the blocks on a free list instead of freeing them,
+// so an arena that is reset between searches of similar size
+// stops calling the system allocator once it has warmed up.
+// single objects can be given back with free() and are reused by alloc().
 
 template <typename T, int NBlock = 4096>
 class Arena
 {
 public:
+	using value_type = T;
+
+	// at most max_free_blocks empty blocks are kept by reset().
+	explicit Arena(size_t max_free_blocks = std::numeric_limits<size_t>::max())
+		: max_free_blocks(max_free_blocks)
+	{
+	}
+
 	// arguments are forwarded to T constructor.
 	template <typename... Args> T *alloc(Args... args)
 	{
+		if (!free_objects.empty()) {
+			T *p = free_objects.back();
+			free_objects.pop_back();
+			p->~T();
+			return new (p) T(std::forward<Args...>(args...));
+		}
 		if (blocks.empty() || blocks.front().size() == NBlock) {
-			blocks.emplace_front();
-			blocks.front().reserve(NBlock);
+			_next_block();
 		}
 		blocks.front().emplace_back(std::forward<Args...>(args...));
+		++n_used;
 		return &blocks.front().back();
 	}
 
+	// give back an object for reuse by a later alloc().
+	// it is only destroyed when reused or when the arena is reset.
+	void free(T *p)
+	{
+		free_objects.push_back(p);
+	}
+
+	// number of live objects.
+	size_t size() const
+	{
+		return n_used - free_objects.size();
+	}
+
+	// destroy all objects but keep the blocks for reuse,
+	// up to the high-water mark.
+	void reset()
+	{
+		for (std::vector<T> &block : blocks) {
+			block.clear();
+			++n_free_blocks;
+		}
+		free_blocks.splice_after(free_blocks.before_begin(), blocks);
+		_trim();
+		free_objects.clear();
+		n_used = 0;
+	}
+
+	// destroy all objects and free all blocks.
 	void clear()
 	{
-		// TODO could reuse blocks, but better to set NBlock large enough
-		// that the malloc/freeing should be insignificant
 		blocks.clear();
+		free_blocks.clear();
+		n_free_blocks = 0;
+		free_objects.clear();
+		free_objects.shrink_to_fit();
+		n_used = 0;
+	}
+
+	// change the number of empty blocks kept by reset().
+	void set_high_water(size_t max_free)
+	{
+		max_free_blocks = max_free;
+		_trim();
+	}
+
+	size_t n_spare_blocks() const
+	{
+		return n_free_blocks;
 	}
 
 private:
 	std::forward_list<std::vector<T>> blocks;
-};
+	std::forward_list<std::vector<T>> free_blocks;
+	size_t n_free_blocks = 0;
+	size_t max_free_blocks;
+	// objects given back by free(). keeps its capacity across reset().
+	std::vector<T *> free_objects;
+	size_t n_used = 0;
 
+	// splicing moves list nodes, so reusing a block allocates nothing.
+	void _next_block()
+	{
+		if (free_blocks.empty()) {
+			blocks.emplace_front();
+			blocks.front().reserve(NBlock);
+		} else {
+			blocks.splice_after(blocks.before_begin(),
+			                    free_blocks, free_blocks.before_begin());
+			--n_free_blocks;
+		}
+	}
+
+	void _trim()
+	{
+		while (n_free_blocks > max_free_blocks) {
+			free_blocks.pop_front();
+			--n_free_blocks;
+		}
+	}
+};
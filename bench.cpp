@@ -0,0 +1,703 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connect4.hpp"
+#include "mcts.hpp"
+#include "mmap_arena.hpp"
+#include "parallel.hpp"
+#include "sparse_node.hpp"
+#include "tictactoe.hpp"
+#include "transposition.hpp"
+
+// throughput benchmarks for the search.
+// run with `make bench && ./bench [section...]`.
+
+using Clock = std::chrono::steady_clock;
+
+// calls to the system allocator, counted by the operator new below.
+static std::atomic<size_t> n_allocations{0};
+
+void *operator new(size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
+static double seconds_since(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// the machine may be noisy, so report the best of a few repetitions.
+static int const REPEAT = 5;
+
+// rollouts per second from the initial state into a fresh tree,
+// until n_rollouts or until the root is solved.
+// the tree's node type is the one held by NodeArena.
+template <typename Game, typename NodeArena = typename mcts::Node<Game>::MyArena,
+          typename... ArenaArgs>
+void bench_rollouts(char const *name, size_t n_rollouts, ArenaArgs... arena_args)
+{
+	double best = 0.0;
+	for (int r = 0; r < REPEAT; ++r) {
+		std::default_random_engine prng(r);
+		NodeArena arena(arena_args...);
+		auto *tree = arena.alloc(Game());
+
+		auto const start = Clock::now();
+		size_t i = 0;
+		for (; i < n_rollouts && !tree->is_solved(); ++i) {
+			tree->ucb_rollout(prng, arena);
+		}
+		best = std::max(best, i / seconds_since(start));
+	}
+	std::cout << name << ": " << best / 1e3 << " k rollouts/s\n";
+}
+
+// score of the Select policy against the default UCB1, in games of
+// ConnectFour with n_rollouts from a fresh tree per move, and its speed.
+// both sides play best_move(), as the library does, so only the search
+// differs. the two sides alternate colors. a tie scores half.
+template <typename Select>
+void bench_policy(char const *name, size_t n_rollouts, uint n_games)
+{
+	using Mine = mcts::Node<ConnectFour, mcts::PointerLinks, Select>;
+	using Theirs = mcts::Node<ConnectFour>;
+
+	auto search_move = [n_rollouts](auto *tree, auto &arena, auto &prng) {
+		mcts::search(tree, prng, arena, n_rollouts);
+		return tree->best_move(arena);
+	};
+
+	std::default_random_engine prng(1);
+	double score = 0.0, seconds = 0.0;
+	size_t n_searches = 0;
+	for (uint g = 0; g < n_games; ++g) {
+		uint const my_player = g % 2;
+		ConnectFour state;
+		while (state.winner() == mcts::NONE) {
+			uint move;
+			if (state.player_turn() == my_player) {
+				typename Mine::MyArena arena;
+				auto const start = Clock::now();
+				move = search_move(arena.alloc(ConnectFour(state)), arena, prng);
+				seconds += seconds_since(start);
+				++n_searches;
+			} else {
+				typename Theirs::MyArena arena;
+				move = search_move(arena.alloc(ConnectFour(state)), arena, prng);
+			}
+			state = state.move(move);
+		}
+		mcts::WinState const w = state.winner();
+		score += (w == mcts::TIE) ? 0.5 : (w == (my_player == 0 ? mcts::WIN : mcts::LOSS));
+	}
+	std::cout << name << ": " << score / n_games << " score vs. UCB1, "
+	          << n_searches * n_rollouts / seconds / 1e3 << " k rollouts/s\n";
+}
+
+// time per rollout spent in each stage, from the initial state, until
+// n_rollouts or until the root is solved. the clock is read between
+// stages, which adds some overhead to each.
+template <typename Game>
+void bench_stages(char const *name, size_t n_rollouts)
+{
+	using S = mcts::Search<Game>;
+	std::default_random_engine prng(1);
+	typename S::TreeNode::MyArena arena;
+	auto *root = arena.alloc(Game());
+	typename S::Path path;
+	double t[4] = {};
+	auto lap = [&t](int stage, Clock::time_point &start) {
+		auto const now = Clock::now();
+		t[stage] += std::chrono::duration<double>(now - start).count();
+		start = now;
+	};
+	size_t n = 0;
+	for (; n < n_rollouts && !root->is_solved(); ++n) {
+		auto start = Clock::now();
+		uint const depth = S::select(root, prng, arena, path);
+		lap(0, start);
+		mcts::WinState winner;
+		auto const &last = path[depth > 0 ? depth - 1 : 0];
+		if (depth == 0) {
+			winner = root->proven_value();
+		} else if (!last.node->is_move_explored(last.move)) {
+			Game const leaf = S::expand(last, arena, std::numeric_limits<size_t>::max());
+			lap(1, start);
+			winner = S::simulate(leaf, prng);
+			lap(2, start);
+		} else {
+			winner = last.node->child(last.move)->proven_value();
+		}
+		S::backprop(path, depth, winner);
+		S::prove(path, depth, arena);
+		lap(3, start);
+	}
+	std::cout << name << " ns/rollout: select " << t[0] / n * 1e9
+	          << ", expand " << t[1] / n * 1e9
+	          << ", simulate " << t[2] / n * 1e9
+	          << ", backprop " << t[3] / n * 1e9 << "\n";
+}
+
+// rollouts until the search settles on the right reply to a corner
+// opening in TicTacToe: the center is the only move that does not lose.
+// the search is checked every STEP rollouts, and has settled at the
+// first check after which it never picks another move. averaged over
+// seeds, and max_rollouts if it does not settle.
+template <typename NodeArena>
+double rollouts_to_settle(size_t max_rollouts)
+{
+	uint const N_SEEDS = 20, STEP = 50;
+	double total = 0.0;
+	for (uint seed = 0; seed < N_SEEDS; ++seed) {
+		std::default_random_engine prng(seed);
+		NodeArena arena;
+		auto *root = arena.alloc(TicTacToe().move(0));
+		size_t settled = max_rollouts;
+		for (size_t n = STEP; n <= max_rollouts; n += STEP) {
+			mcts::search(root, prng, arena, STEP);
+			if (root->ucb_move(arena) != 4) {
+				settled = max_rollouts;
+			} else if (settled == max_rollouts) {
+				settled = n;
+			}
+		}
+		total += settled;
+	}
+	return total / N_SEEDS;
+}
+
+// nodes and rollouts saved by sharing the nodes of transposed states.
+template <typename Game>
+void bench_transpositions(char const *name, size_t n_rollouts)
+{
+	using TreeNode = mcts::Node<Game>;
+	using TTArena = mcts::TranspositionArena<typename TreeNode::MyArena>;
+
+	std::default_random_engine prng(1);
+	typename TreeNode::MyArena tree_arena;
+	mcts::search(tree_arena.alloc(Game()), prng, tree_arena, n_rollouts);
+	TTArena dag_arena;
+	mcts::search(dag_arena.alloc(Game()), prng, dag_arena, n_rollouts);
+	std::cout << name << " nodes after " << n_rollouts << " rollouts: tree "
+	          << tree_arena.size() << ", transpositions " << dag_arena.size() << "\n";
+}
+
+// rollouts until the search proves the game-theoretic value of state,
+// or max_rollouts if it does not.
+template <typename NodeArena, typename Game>
+void bench_solver(char const *name, Game const &state, size_t max_rollouts)
+{
+	std::default_random_engine prng(1);
+	NodeArena arena;
+	auto *root = arena.alloc(Game(state));
+	auto const start = Clock::now();
+	size_t const n = mcts::search(root, prng, arena, max_rollouts);
+	double const t = seconds_since(start);
+	std::cout << name << ": value " << int(root->proven_value()) << " after " << n
+	          << " rollouts, " << arena.size() << " nodes, " << t * 1e3 << " ms\n";
+}
+
+// rollouts done within time_per_search from the initial state, and
+// how late search_until() returns past its deadline.
+template <typename Game>
+void bench_deadline(char const *name, std::chrono::microseconds time_per_search)
+{
+	using TreeNode = mcts::Node<Game>;
+	size_t const N_SEARCHES = 20;
+	size_t total = 0;
+	double late_sum = 0.0, late_max = 0.0;
+	for (size_t r = 0; r < N_SEARCHES; ++r) {
+		std::default_random_engine prng(r);
+		typename TreeNode::MyArena arena;
+		auto *root = arena.alloc(Game());
+		auto const deadline = Clock::now() + time_per_search;
+		total += mcts::search_until(root, prng, arena, deadline);
+		double const late = std::chrono::duration<double>(Clock::now() - deadline).count();
+		late_sum += late;
+		late_max = std::max(late_max, late);
+	}
+	std::cout << name << ", " << time_per_search.count() << " us: "
+	          << total / N_SEARCHES << " rollouts, late by " << late_sum / N_SEARCHES * 1e6
+	          << " us on average, " << late_max * 1e6 << " us at most\n";
+}
+
+// calls to the system allocator per cycle of reset() and a search of
+// n_rollouts into the same arena. a new seed per cycle, so the trees
+// differ in shape, but not much in size.
+template <typename Game, typename NodeArena>
+void bench_reset_allocations(char const *name, size_t n_rollouts, uint n_cycles)
+{
+	NodeArena arena;
+	std::cout << name << " allocations per cycle:";
+	for (uint cycle = 0; cycle < n_cycles; ++cycle) {
+		std::default_random_engine prng(cycle);
+		size_t const before = n_allocations.load();
+		arena.reset();
+		mcts::search(arena.alloc(Game()), prng, arena, n_rollouts);
+		std::cout << " " << n_allocations.load() - before;
+	}
+	std::cout << "\n";
+}
+
+// Search::rollout written recursively, as before selection and
+// backpropagation were iterative: one call per ply, each updating its
+// own edge on the way back up. built from the public stages, so it
+// grows the same tree. the edge of each call is backed up as one ply,
+// which only matters to a Backprop that uses plies.
+template <typename S, typename RandomGen, typename NodeArena>
+mcts::WinState rollout_recursive(typename S::TreeNode *node, RandomGen &rng,
+                                 NodeArena &arena, size_t max_nodes)
+{
+	if (node->is_solved()) return node->proven_value();
+	typename S::Path step;
+	uint const move = node->is_fully_expanded()
+		? node->select_move(rng, arena) : mcts::ExpandRandom::pick(*node, rng);
+	step[0] = {node, move};
+	mcts::WinState const winner = node->is_move_explored(move)
+		? rollout_recursive<S>(node->child(move, arena), rng, arena, max_nodes)
+		: S::simulate(S::expand(step[0], arena, max_nodes), rng);
+	S::backprop(step, 1, winner);
+	S::prove(step, 1, arena);
+	return winner;
+}
+
+// rollouts per second from the initial state with iterative selection
+// and backpropagation (Search::rollout) vs. recursive ones.
+template <typename Game>
+void bench_recursion(char const *name, size_t n_rollouts)
+{
+	using S = mcts::Search<Game>;
+	auto rate = [n_rollouts](bool recursive) {
+		double best = 0.0;
+		for (int r = 0; r < REPEAT; ++r) {
+			std::default_random_engine prng(r);
+			typename S::TreeNode::MyArena arena;
+			auto *root = arena.alloc(Game());
+			size_t const max_nodes = std::numeric_limits<size_t>::max();
+			auto const start = Clock::now();
+			size_t i = 0;
+			for (; i < n_rollouts && !root->is_solved(); ++i) {
+				if (recursive) {
+					rollout_recursive<S>(root, prng, arena, max_nodes);
+				} else {
+					S::rollout(root, prng, arena, max_nodes);
+				}
+			}
+			best = std::max(best, i / seconds_since(start));
+		}
+		return best;
+	};
+	std::cout << name << ": iterative " << rate(false) / 1e3
+	          << " k rollouts/s, recursive " << rate(true) / 1e3 << " k rollouts/s\n";
+}
+
+// share of the rollouts an EarlyStop rule saves, and how often it
+// still picks the move of the full search. searches from the states
+// of random games, with n_rollouts each, same seeds for both.
+template <typename Game>
+void bench_early_stop(char const *name, mcts::EarlyStop const &stop,
+                      size_t n_rollouts, uint n_states)
+{
+	using TreeNode = mcts::Node<Game>;
+	std::default_random_engine game_prng(1);
+	size_t n_done = 0;
+	uint n_same = 0, n_searched = 0;
+	Game state;
+	while (n_searched < n_states) {
+		if (state.winner() != mcts::NONE) state = Game();
+		uint moves[2];
+		size_t done[2];
+		for (int early = 0; early < 2; ++early) {
+			std::default_random_engine prng(n_searched);
+			typename TreeNode::MyArena arena;
+			auto *root = arena.alloc(Game(state));
+			done[early] = mcts::search(root, prng, arena, n_rollouts, mcts::MemoryBudget<>(),
+			                           early ? stop : mcts::EarlyStop());
+			moves[early] = root->best_move(arena);
+		}
+		// solved roots stop early either way.
+		if (done[0] == n_rollouts) {
+			n_done += done[1];
+			n_same += moves[0] == moves[1];
+			++n_searched;
+		}
+		state = state.move(mcts::random_move(state, game_prng));
+	}
+	std::cout << name << ": " << 100.0 * n_done / (n_rollouts * n_states)
+	          << "% of rollouts done, " << 100.0 * n_same / n_states << "% same move\n";
+}
+
+// rollouts per second of a parallel search with 1 to 8 threads and a
+// fixed total budget, and the speedup over one thread.
+// search(n_threads, seeds) runs the search and returns its move.
+template <typename ParallelSearch>
+void bench_parallel(char const *name, size_t n_rollouts, ParallelSearch search)
+{
+	std::vector<uint> const seeds = {1, 2, 3, 4, 5, 6, 7, 8};
+	double one_thread = 0.0;
+	for (uint n_threads : {1, 2, 4, 8}) {
+		double best = 0.0;
+		for (int r = 0; r < REPEAT; ++r) {
+			auto const start = Clock::now();
+			search(n_threads, seeds);
+			best = std::max(best, n_rollouts / seconds_since(start));
+		}
+		if (n_threads == 1) one_thread = best;
+		std::cout << name << ", " << n_threads << " threads: " << best / 1e3
+		          << " k rollouts/s, speedup " << best / one_thread << "\n";
+	}
+}
+
+// time per random playout from the initial state, picking moves
+// by calling is_valid per move vs. from valid_moves_mask().
+template <typename Game>
+void bench_playout(char const *name, size_t n_playouts)
+{
+	auto time_ns = [n_playouts](auto has_mask) {
+		std::default_random_engine prng(1);
+		double best = 1e30;
+		int sink = 0;
+		for (int r = 0; r < REPEAT; ++r) {
+			auto const start = Clock::now();
+			for (size_t i = 0; i < n_playouts; ++i) {
+				Game state;
+				while (state.winner() == mcts::NONE) {
+					state = state.move(mcts::random_move(state, prng, has_mask));
+				}
+				sink += state.winner();
+			}
+			best = std::min(best, seconds_since(start) / n_playouts * 1e9);
+		}
+		// keep the playouts from being optimized away.
+		if (sink == 0x7FFFFFFF) std::cout << "";
+		return best;
+	};
+	std::cout << name << " ns/playout: is_valid " << time_ns(std::false_type())
+	          << ", valid_moves_mask " << time_ns(std::true_type()) << "\n";
+}
+
+// memory footprint of a node layout.
+template <typename Node>
+void bench_layout(char const *name)
+{
+	std::cout << name << ": " << sizeof(Node) << " bytes/node, "
+	          << (1u << 30) / sizeof(Node) / 1e6 << " M nodes/GB\n";
+}
+
+// tree memory after n_rollouts from the initial state.
+template <typename Game, typename NodeArena>
+void bench_memory(char const *name, size_t n_rollouts)
+{
+	std::default_random_engine prng(1);
+	NodeArena arena;
+	auto *tree = arena.alloc(Game());
+	for (size_t i = 0; i < n_rollouts; ++i) {
+		tree->ucb_rollout(prng, arena);
+	}
+	double const bytes = double(arena.size()) * sizeof(*tree);
+	std::cout << name << ": " << bytes / 1e6 << " MB, "
+	          << bytes / n_rollouts << " bytes/rollout\n";
+}
+
+// tree memory and speed of a search of n_rollouts from the initial
+// state within budget.
+template <typename Game, typename NodeArena, typename Budget>
+void bench_budget(char const *name, size_t n_rollouts, Budget const &budget)
+{
+	std::default_random_engine prng(1);
+	NodeArena arena;
+	auto *tree = arena.alloc(Game());
+	auto const start = Clock::now();
+	mcts::search(tree, prng, arena, n_rollouts, budget);
+	double const t = seconds_since(start);
+	std::cout << name << ": " << double(arena.size()) * sizeof(*tree) / 1e6 << " MB, "
+	          << n_rollouts / t / 1e3 << " k rollouts/s\n";
+}
+
+// time per UCB selection over one node's edges, scalar vs. vectorized.
+// about 80% of the moves are valid, as in a mid-game position.
+static void bench_select(uint n_moves)
+{
+	uint const N_NODES = 256;
+	uint const n_words = (n_moves + 63) / 64;
+	std::mt19937 gen(1);
+	std::vector<float> tries(N_NODES * n_moves), wins(N_NODES * n_moves);
+	std::vector<uint64_t> valid(N_NODES * n_words);
+	for (uint i = 0; i < N_NODES * n_moves; ++i) {
+		uint const node = i / n_moves, move = i % n_moves;
+		if (gen() % 5 != 0) {
+			valid[node * n_words + move / 64] |= uint64_t(1) << (move % 64);
+		}
+		tries[i] = 1.0f + gen() % 100;
+		wins[i] = float(int(gen() % 201) - 100) * tries[i] / 100.0f;
+	}
+
+	float const explore = mcts::explore_term(1000.0f);
+	auto time_ns = [&](decltype(&mcts::ucb_argmax) select) {
+		uint const REPS = 20'000'000 / (n_moves * N_NODES) + 1;
+		uint sink = 0;
+		double best = 1e30;
+		for (int r = 0; r < REPEAT; ++r) {
+			auto const start = Clock::now();
+			for (uint rep = 0; rep < REPS; ++rep) {
+				for (uint k = 0; k < N_NODES; ++k) {
+					sink += select(&tries[k * n_moves], &wins[k * n_moves],
+					               &valid[k * n_words], n_moves, 1.0f, explore);
+				}
+			}
+			best = std::min(best, seconds_since(start) / (REPS * N_NODES) * 1e9);
+		}
+		// keep the calls from being optimized away.
+		if (sink == 0xFFFFFFFF) std::cout << "";
+		return best;
+	};
+
+	std::cout << "select " << n_moves << " moves: scalar "
+	          << time_ns(mcts::ucb_argmax_scalar) << " ns, simd "
+	          << time_ns(mcts::ucb_argmax) << " ns\n";
+}
+
+// time per logarithm: std::log vs. fastlog vs. fastlog_v,
+// and per exploration term: computed vs. looked up.
+static void bench_log()
+{
+	uint const N = 4096;
+	std::vector<float> x(N), y(N);
+	for (uint i = 0; i < N; ++i) {
+		x[i] = 1.0f + 37.0f * i;
+	}
+
+	auto time_ns = [&](auto &&fill) {
+		uint const REPS = 2000;
+		double best = 1e30;
+		for (int r = 0; r < REPEAT; ++r) {
+			auto const start = Clock::now();
+			for (uint rep = 0; rep < REPS; ++rep) {
+				fill();
+			}
+			best = std::min(best, seconds_since(start) / (REPS * N) * 1e9);
+		}
+		// keep the calls from being optimized away.
+		if (y[N / 2] == 0.0f) std::cout << "";
+		return best;
+	};
+
+	std::cout << "log: std::log "
+	          << time_ns([&]() { for (uint i = 0; i < N; ++i) y[i] = std::log(x[i]); })
+	          << " ns, fastlog "
+	          << time_ns([&]() { for (uint i = 0; i < N; ++i) y[i] = fastlog(x[i]); })
+	          << " ns";
+#if defined(__AVX512F__)
+	std::cout << ", fastlog_v x16 " << time_ns([&]() {
+		for (uint i = 0; i < N; i += 16) {
+			_mm512_storeu_ps(&y[i], fastlog_v(_mm512_loadu_ps(&x[i])));
+		}
+	}) << " ns";
+#endif
+#if defined(__AVX2__)
+	std::cout << ", fastlog_v x8 " << time_ns([&]() {
+		for (uint i = 0; i < N; i += 8) {
+			_mm256_storeu_ps(&y[i], fastlog_v(_mm256_loadu_ps(&x[i])));
+		}
+	}) << " ns";
+#endif
+	std::cout << "\n";
+
+	// visit counts are integers, as they are during sequential search.
+	for (uint i = 0; i < N; ++i) {
+		x[i] = float(1 + (i * 37) % 20000);
+	}
+	std::cout << "exploration term: computed "
+	          << time_ns([&]() { for (uint i = 0; i < N; ++i) y[i] = mcts::explore_term_uncached(x[i]); })
+	          << " ns, table "
+	          << time_ns([&]() { for (uint i = 0; i < N; ++i) y[i] = mcts::explore_term(x[i]); })
+	          << " ns\n";
+}
+
+// run with the names of the sections to run, or none to run them all.
+int main(int argc, char **argv)
+{
+	auto run = [argc, argv](char const *section) {
+		if (argc == 1) return true;
+		for (int i = 1; i < argc; ++i) {
+			if (strcmp(argv[i], section) == 0) return true;
+		}
+		return false;
+	};
+
+	if (run("log")) {
+		bench_log();
+	}
+
+	if (run("select")) {
+		bench_select(9);
+		bench_select(64);
+		bench_select(361);
+	}
+
+	if (run("playout")) {
+		bench_playout<TicTacToe>("TicTacToe", 1'000'000);
+		bench_playout<ConnectFour>("ConnectFour", 300'000);
+	}
+
+	if (run("rollouts")) {
+		bench_rollouts<TicTacToe>("TicTacToe", 1'000'000);
+		bench_rollouts<ConnectFour>("ConnectFour", 300'000);
+	}
+
+	if (run("recursion")) {
+		bench_recursion<TicTacToe>("TicTacToe", 1'000'000);
+		bench_recursion<ConnectFour>("ConnectFour", 300'000);
+	}
+
+	// big trees, where TLB misses during descent start to matter.
+	using C4Node = mcts::Node<ConnectFour>;
+	size_t const BIG = 1'000'000;
+	if (run("arena")) {
+		bench_rollouts<ConnectFour>("ConnectFour big, Arena", BIG);
+		bench_rollouts<ConnectFour, MmapArena<C4Node>>(
+			"ConnectFour big, MmapArena 4k pages", BIG, size_t(1) << 32, Pages::NORMAL);
+		bench_rollouts<ConnectFour, MmapArena<C4Node>>(
+			"ConnectFour big, MmapArena huge pages", BIG, size_t(1) << 32, Pages::TRANSPARENT_HUGE);
+	}
+
+	// searches within a memory budget.
+	if (run("budget")) {
+		using C4Sparse = mcts::SparseNode<ConnectFour>;
+		size_t const N = 200'000;
+		mcts::MemoryBudget<> unbounded, stop;
+		mcts::MemoryBudget<mcts::OnBudget::PRUNE> prune;
+		stop.bytes = prune.bytes = size_t(4) << 20;
+		bench_budget<ConnectFour, C4Node::MyArena>("ConnectFour, unbounded", N, unbounded);
+		bench_budget<ConnectFour, C4Node::MyArena>("ConnectFour, 4 MB, stop expanding", N, stop);
+		bench_budget<ConnectFour, C4Node::MyArena>("ConnectFour, 4 MB, prune", N, prune);
+		bench_budget<ConnectFour, C4Sparse::MyArena>("ConnectFour, SparseNode, 4 MB, stop expanding", N, stop);
+		bench_budget<ConnectFour, C4Sparse::MyArena>("ConnectFour, SparseNode, 4 MB, prune", N, prune);
+	}
+
+	// system allocator calls once the arenas have warmed up.
+	if (run("reset")) {
+		using C4Sparse = mcts::SparseNode<ConnectFour>;
+		bench_reset_allocations<ConnectFour, C4Node::MyArena>("ConnectFour, Node", 100'000, 8);
+		bench_reset_allocations<ConnectFour, C4Sparse::MyArena>("ConnectFour, SparseNode", 100'000, 8);
+	}
+
+	// pointer vs. 32-bit index child links.
+	using C4IndexNode = mcts::Node<ConnectFour, mcts::IndexLinks>;
+	if (run("links")) {
+		bench_layout<mcts::Node<TicTacToe>>("TicTacToe, pointer links");
+		bench_layout<mcts::Node<TicTacToe, mcts::IndexLinks>>("TicTacToe, index links");
+		bench_layout<C4Node>("ConnectFour, pointer links");
+		bench_layout<C4IndexNode>("ConnectFour, index links");
+		bench_rollouts<ConnectFour, MmapArena<C4IndexNode>>(
+			"ConnectFour big, MmapArena 4k pages, index links", BIG, size_t(1) << 32, Pages::NORMAL);
+	}
+
+	if (run("stages")) {
+		bench_stages<TicTacToe>("TicTacToe", 1'000'000);
+		bench_stages<ConnectFour>("ConnectFour", 300'000);
+	}
+
+	// trees vs. DAGs with a transposition table.
+	if (run("transpose")) {
+		bench_transpositions<TicTacToe>("TicTacToe", 100'000);
+		bench_transpositions<ConnectFour>("ConnectFour", 300'000);
+		using TTTNode = mcts::Node<TicTacToe>;
+		size_t const MAX = 20'000;
+		std::cout << "TicTacToe rollouts to settle after a corner opening: tree "
+		          << rollouts_to_settle<TTTNode::MyArena>(MAX) << ", transpositions "
+		          << rollouts_to_settle<mcts::TranspositionArena<TTTNode::MyArena>>(MAX) << "\n";
+	}
+
+	// MCTS-Solver: proven values end the search early.
+	if (run("solver")) {
+		using TTTNode = mcts::Node<TicTacToe>;
+		size_t const MAX = 1'000'000;
+		bench_solver<TTTNode::MyArena>("TicTacToe, tree", TicTacToe(), MAX);
+		bench_solver<mcts::TranspositionArena<TTTNode::MyArena>>("TicTacToe, transpositions",
+		                                                         TicTacToe(), MAX);
+		// X has three in the bottom row, open at both ends.
+		ConnectFour c4;
+		for (uint col : {3, 3, 4, 4, 2}) c4 = c4.move(col);
+		bench_solver<C4Node::MyArena>("ConnectFour, double threat", c4, MAX);
+	}
+
+	// searches with a wall-clock deadline.
+	if (run("deadline")) {
+		for (long us : {1'000, 10'000, 100'000}) {
+			bench_deadline<ConnectFour>("ConnectFour", std::chrono::microseconds(us));
+		}
+	}
+
+	// stopping rules for a fixed budget of rollouts.
+	if (run("stop")) {
+		mcts::EarlyStop uncatchable;
+		uncatchable.uncatchable = true;
+		mcts::EarlyStop confident;
+		confident.confidence = 3.0f;
+		for (size_t n : {10'000, 100'000}) {
+			std::cout << n << " rollouts per search\n";
+			bench_early_stop<ConnectFour>("ConnectFour, uncatchable", uncatchable, n, 40);
+			bench_early_stop<ConnectFour>("ConnectFour, 3 standard errors", confident, n, 40);
+		}
+	}
+
+	// root parallelization. the speedup is bounded by the number of cores.
+	if (run("parallel")) {
+		std::cout << std::thread::hardware_concurrency() << " hardware threads\n";
+		size_t const N = 400'000;
+		bench_parallel("ConnectFour, root parallel", N, [N](uint n_threads, std::vector<uint> const &seeds) {
+			return mcts::root_parallel_search<ConnectFour>(n_threads, N, seeds);
+		});
+		for (float virtual_loss : {0.0f, 1.0f, 3.0f}) {
+			std::string const name = "ConnectFour, tree parallel, virtual loss "
+				+ std::to_string(int(virtual_loss));
+			bench_parallel(name.c_str(), N, [N, virtual_loss](uint n_threads, std::vector<uint> const &seeds) {
+				return mcts::tree_parallel_search<ConnectFour>(n_threads, N, seeds, virtual_loss);
+			});
+		}
+	}
+
+	// selection policies at a fixed number of rollouts per move.
+	if (run("policy")) {
+		size_t const N_ROLLOUTS = 2000;
+		uint const N_GAMES = 100;
+		bench_policy<mcts::UCB1<>>("UCB1", N_ROLLOUTS, N_GAMES);
+		bench_policy<mcts::UCB1<std::ratio<1, 2>>>("UCB1 C=1/2", N_ROLLOUTS, N_GAMES);
+		bench_policy<mcts::UCB1Tuned>("UCB1-Tuned", N_ROLLOUTS, N_GAMES);
+		bench_policy<mcts::PUCT<>>("PUCT", N_ROLLOUTS, N_GAMES);
+		bench_policy<mcts::Thompson>("Thompson", N_ROLLOUTS, N_GAMES);
+	}
+
+	// dense vs. sparse edges.
+	using C4Sparse = mcts::SparseNode<ConnectFour>;
+	if (run("sparse")) {
+		bench_memory<ConnectFour, C4Node::MyArena>("ConnectFour, Node", 200'000);
+		bench_memory<ConnectFour, C4Sparse::MyArena>("ConnectFour, SparseNode", 200'000);
+		bench_rollouts<ConnectFour, C4Sparse::MyArena>("ConnectFour big, SparseNode", BIG);
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#include "mcts.hpp"
+
+// Connect Four example game for Monte Carlo Tree Search.
+// much deeper than Tic Tac Toe: up to 42 moves per game.
+
+class ConnectFour
+{
+public:
+	static uint constexpr n_moves() { return 7; }
+	static uint constexpr max_depth() { return 42; }
+
+	uint player_turn() const { return iplayer; }
+
+	mcts::WinState winner() const
+	{
+		if (is_win(bits[0])) return mcts::WIN;
+		if (is_win(bits[1])) return mcts::LOSS;
+		if (n_played == 42) return mcts::TIE;
+		return mcts::NONE;
+	}
+
+	uint n_valid_moves() const
+	{
+		uint n = 0;
+		for (uint col = 0; col < 7; ++col) {
+			n += (height[col] < 6);
+		}
+		return n;
+	}
+
+	bool is_valid(int move) const
+	{
+		return height[move] < 6;
+	}
+
+	uint64_t valid_moves_mask() const
+	{
+		uint64_t mask = 0;
+		for (uint col = 0; col < 7; ++col) {
+			mask |= uint64_t(height[col] < 6) << col;
+		}
+		return mask;
+	}
+
+	ConnectFour move(uint col) const
+	{
+		ConnectFour c = *this;
+		c.bits[iplayer] |= uint64_t(1) << (7*col + height[col]);
+		++c.height[col];
+		++c.n_played;
+		c.iplayer = (iplayer + 1) & 1;
+		return c;
+	}
+
+	// in a column of height h, the occupied cells are its low h bits and
+	// player 0's stones s are some of them, so their sum 2^h - 1 + s lies
+	// in [2^h - 1, 2^(h+1) - 2]. these ranges are disjoint for different
+	// heights and stay within the column's 7 bits, so each column's sum
+	// gives back both h and s, and the total identifies the state.
+	uint64_t hash() const
+	{
+		return bits[0] + (bits[0] | bits[1]);
+	}
+
+	friend std::ostream &operator<<(std::ostream &s, ConnectFour const &c4);
+
+private:
+	// each column is 7 bits, bottom row first, with an always-empty
+	// top bit so that lines cannot wrap around into the next column.
+	static bool is_win(uint64_t b)
+	{
+		// vertical, horizontal and both diagonals.
+		for (int d : {1, 7, 6, 8}) {
+			uint64_t const pairs = b & (b >> d);
+			if (pairs & (pairs >> 2*d)) return true;
+		}
+		return false;
+	}
+
+	uint64_t bits[2] = {0, 0};
+	uint8_t height[7] = {};
+	uint8_t n_played = 0;
+	uint8_t iplayer = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &s, ConnectFour const &c4)
+{
+	for (int row = 5; row >= 0; --row) {
+		for (int col = 0; col < 7; ++col) {
+			uint64_t const pos = uint64_t(1) << (7*col + row);
+			if (c4.bits[0] & pos) s << "X";
+			else if (c4.bits[1] & pos) s << "O";
+			else s << "-";
+		}
+		s << "\n";
+	}
+	return s;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+#include "fastlog.hpp"
+
+// the exploration term of UCB1 for one node: sqrt(2 * ln(n)), where n is
+// the node's total number of tries. it is the same for all of the node's
+// edges, so selection computes it once and each edge then only needs
+//   flip * wins[i] / tries[i] + explore / sqrt(tries[i]).
+//
+// tries are counts stored as floats, so for n below the table size the
+// term is looked up instead of computed. the table is exact (std::log),
+// and fractional counts (from virtual loss) or larger ones use fastlog.
+// define MCTS_EXPLORE_TABLE_SIZE to change the table size; 0 disables it.
+
+#ifndef MCTS_EXPLORE_TABLE_SIZE
+#define MCTS_EXPLORE_TABLE_SIZE (1 << 16)
+#endif
+
+namespace mcts
+{
+
+using uint = unsigned int;
+
+inline float explore_term_uncached(float n)
+{
+	return sqrtf(2.0f * fastlog(n + 1e-4f));
+}
+
+#if MCTS_EXPLORE_TABLE_SIZE > 0
+
+// 256 kB with the default size.
+template <uint N>
+class ExploreTable
+{
+public:
+	ExploreTable()
+	{
+		// ln(0) is undefined, and a node is only selected from once
+		// it has tries, so the first entry is never used.
+		table[0] = 0.0f;
+		for (uint n = 1; n < N; ++n) {
+			table[n] = float(std::sqrt(2.0 * std::log(double(n))));
+		}
+	}
+
+	static ExploreTable const instance;
+
+	float operator()(float n) const
+	{
+		uint const i = uint(n);
+		if (i < N && float(i) == n) return table[i];
+		return explore_term_uncached(n);
+	}
+
+private:
+	std::array<float, N> table;
+};
+
+// built during static initialization, so lookups need no guard.
+// it is not ready yet for searches run from other static initializers.
+template <uint N>
+ExploreTable<N> const ExploreTable<N>::instance;
+
+inline float explore_term(float n)
+{
+	return ExploreTable<MCTS_EXPLORE_TABLE_SIZE>::instance(n);
+}
+
+#else
+
+inline float explore_term(float n)
+{
+	return explore_term_uncached(n);
+}
+
+#endif
+
+} // namespace mcts
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
 // computing the natural logarithm is a bottleneck of UCB.
 // we take advantage of fast approximate logarithm calculations.
+// fastlog(x) is within 1.1e-4 of std::log(x) for 1e-4 <= x <= 1e9.
 static float const log_radix = 10e6f;
 static float const log_of_radix = log2f(log_radix);
 
@@ -27,3 +33,64 @@ fastlog (float x)
 	return 0.69314718f * (fastlog2 (x/log_radix) + log_of_radix);
 }
 
+
+// vectorized versions of fastlog, same formula and error, 8 or 16 lanes.
+// also a fast approximate 1/sqrt(x) for x > 0: the hardware estimate
+// refined by one Newton-Raphson step, within 1.5e-7 relative error for
+// AVX-512 (14-bit estimate) and 2.5e-7 for AVX2 (12-bit estimate).
+// UCB needs 1/n and 1/sqrt(n) per edge, and r = rsqrt(n) gives both,
+// as r*r and r, without any division or square root.
+
+#if defined(__AVX2__)
+
+static inline __m256 fastlog_v(__m256 x)
+{
+	__m256i const vx = _mm256_castps_si256(_mm256_div_ps(x, _mm256_set1_ps(log_radix)));
+	__m256 const mx = _mm256_castsi256_ps(_mm256_or_si256(
+		_mm256_and_si256(vx, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3f000000)));
+	__m256 const y = _mm256_mul_ps(_mm256_cvtepi32_ps(vx), _mm256_set1_ps(1.1920928955078125e-7f));
+
+	__m256 r = _mm256_sub_ps(y, _mm256_set1_ps(124.22551499f));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(_mm256_set1_ps(1.498030302f), mx));
+	r = _mm256_sub_ps(r, _mm256_div_ps(_mm256_set1_ps(1.72587999f),
+	                                   _mm256_add_ps(_mm256_set1_ps(0.3520887068f), mx)));
+	return _mm256_mul_ps(_mm256_set1_ps(0.69314718f),
+	                     _mm256_add_ps(r, _mm256_set1_ps(log_of_radix)));
+}
+
+static inline __m256 fast_rsqrt_v(__m256 x)
+{
+	__m256 const r = _mm256_rsqrt_ps(x);
+	// r * (1.5 - 0.5 * x * r * r)
+	__m256 const hxr2 = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), x), _mm256_mul_ps(r, r));
+	return _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), hxr2));
+}
+
+#endif
+
+#if defined(__AVX512F__)
+
+static inline __m512 fastlog_v(__m512 x)
+{
+	__m512i const vx = _mm512_castps_si512(_mm512_div_ps(x, _mm512_set1_ps(log_radix)));
+	__m512 const mx = _mm512_castsi512_ps(_mm512_or_si512(
+		_mm512_and_si512(vx, _mm512_set1_epi32(0x007FFFFF)), _mm512_set1_epi32(0x3f000000)));
+	__m512 const y = _mm512_mul_ps(_mm512_cvtepi32_ps(vx), _mm512_set1_ps(1.1920928955078125e-7f));
+
+	__m512 r = _mm512_sub_ps(y, _mm512_set1_ps(124.22551499f));
+	r = _mm512_sub_ps(r, _mm512_mul_ps(_mm512_set1_ps(1.498030302f), mx));
+	r = _mm512_sub_ps(r, _mm512_div_ps(_mm512_set1_ps(1.72587999f),
+	                                   _mm512_add_ps(_mm512_set1_ps(0.3520887068f), mx)));
+	return _mm512_mul_ps(_mm512_set1_ps(0.69314718f),
+	                     _mm512_add_ps(r, _mm512_set1_ps(log_of_radix)));
+}
+
+static inline __m512 fast_rsqrt_v(__m512 x)
+{
+	__m512 const r = _mm512_rsqrt14_ps(x);
+	// r * (1.5 - 0.5 * x * r * r)
+	__m512 const hxr2 = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), x), _mm512_mul_ps(r, r));
+	return _mm512_mul_ps(r, _mm512_sub_ps(_mm512_set1_ps(1.5f), hxr2));
+}
+
+#endif
@@ -17,7 +17,15 @@ int main(int argc, char **argv)
 	prng.seed(seed);
 
 	size_t const ROLLOUTS = 100'000;
-	auto history = mcts::play_vs_random<TicTacToe>(prng, ROLLOUTS);
+	// stop a search once its most tried move can no longer change.
+	mcts::EarlyStop stop;
+	stop.uncatchable = true;
+	size_t n_searches = 0, n_done = 0;
+	auto history = mcts::play_vs_random_with<TicTacToe>(prng,
+		[&](auto *tree, auto &arena) {
+			n_done += mcts::search(tree, prng, arena, ROLLOUTS, mcts::MemoryBudget<>(), stop);
+			++n_searches;
+		});
 
 	for (auto &&state : history.first) {
 		std::cout << state << "\n";
@@ -29,5 +37,7 @@ int main(int argc, char **argv)
 	else {
 		std::cout << "player " << winner << " wins\n";
 	}
+	std::cout << "rollouts saved: " << n_searches * ROLLOUTS - n_done
+	          << " of " << n_searches * ROLLOUTS << "\n";
 }
 
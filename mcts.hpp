@@ -3,27 +3,41 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "arena.hpp"
+#include "explore.hpp"
 #include "fastlog.hpp"
+#include "selection.hpp"
+#include "simd.hpp"
 
 /*
 Basic implementation of Monte Carlo Tree Search game-playing algorithm.
 
 Code is optimized in the following ways:
 - using memory arena for tree nodes instead of malloc/new.
-- fast approximate logarithm to compute UCB values.
+- fast approximate logarithm to compute UCB values, and a lookup table
+  of the exploration term for small visit counts (explore.hpp).
 Both of these optimizations are verified with profiler to make a difference.
+UCB selection is also vectorized with AVX2/AVX-512 when available (simd.hpp).
+Other selection rules can be plugged in at compile time (selection.hpp).
 
-The next step would be to use multiple threads, but then
-it is no longer straightforward to follow the UCT exploration rule precisely.
+Using multiple threads makes it no longer straightforward to follow
+the UCT exploration rule precisely.
 MCTS is not embarrassingly parallel and implementing UCT exactly
 would require things like mutexes, barriers, etc.
 "Root parallelization" is a simple and good-performing approach
 where you do N independent MCTS's and merge them at the end.
 (Guillaume Chaslot et al., "Parallel Monte-Carlo Tree Search",
 Int'l Conference on Computers and Games, 2008.)
+It is implemented in parallel.hpp.
 */
 
 namespace mcts
@@ -47,6 +61,9 @@ concept Game
 	// must be constexpr.
 	static uint constexpr n_moves();
 
+	// the maximum number of moves in a game. must be constexpr.
+	static uint constexpr max_depth();
+
 	// whose turn it is. must be in {0, 1}. 0 goes first.
 	uint player_turn() const;
 
@@ -59,112 +76,409 @@ concept Game
 	// true if move 0 <= k < n_moves is valid at current state.
 	bool is_valid(int move) const;
 
+	// optional, for n_moves <= 64: bit k is set if move k is valid.
+	// lets random moves be picked without calling is_valid per move.
+	uint64_t valid_moves_mask() const;
+
 	// play move k return a new state (note, this is a const method!)
 	TicTacToe move(uint k) const;
+
+	// optional: prior probability of move k, used by the PUCT policy.
+	float prior(uint k) const;
+
+	// optional: hash of the state, used by transposition tables.
+	// equal states must have equal hashes, and different states should
+	// not. need not be well mixed, see transposition.hpp.
+	// it is called for every new node, so it should be cheap, e.g.
+	// Zobrist hashing (the xor of one random key per piece) kept in the
+	// state and updated by move() with one xor, or looked up per board.
+	uint64_t hash() const;
 };
 */
 
+template <typename Game, typename = void>
+struct has_valid_moves_mask : std::false_type {};
+
 template <typename Game>
-class Node
+struct has_valid_moves_mask<Game, decltype(void(std::declval<Game const &>().valid_moves_mask()))>
+	: std::true_type {};
+
+// pick a uniformly random valid move.
+template <typename Game, typename RandomGen>
+uint random_move(Game const &state, RandomGen &rng, std::false_type /*has mask*/)
+{
+	uint n = state.n_valid_moves();
+	std::uniform_int_distribution<uint> dist(1, n);
+	uint imove = dist(rng);
+	uint count = 0;
+	for (uint i = 0; i < Game::n_moves(); ++i) {
+		count += state.is_valid(i);
+		if (count == imove) {
+			return i;
+		}
+	}
+	assert(false);
+	return 0xFFFFFFFF;
+}
+
+template <typename Game, typename RandomGen>
+uint random_move(Game const &state, RandomGen &rng, std::true_type /*has mask*/)
+{
+	uint64_t const mask = state.valid_moves_mask();
+	std::uniform_int_distribution<uint> dist(0, popcount(mask) - 1);
+	return select_bit(mask, dist(rng));
+}
+
+template <typename Game, typename RandomGen>
+uint random_move(Game const &state, RandomGen &rng)
 {
+	return random_move(state, rng, has_valid_moves_mask<Game>());
+}
+
+// play random moves until a game end state is reached.
+// aka "simulation" in the UCT paper.
+// states are plain values on the stack, no tree nodes are allocated.
+template <typename Game, typename RandomGen>
+WinState random_playout(Game state, RandomGen &rng)
+{
+	WinState winner;
+	while ((winner = state.winner()) == NONE) {
+		state = state.move(random_move(state, rng));
+	}
+	return winner;
+}
+
+// default stage policies of Search, see below.
+
+// expansion: add a uniformly random untried move to the tree.
+struct ExpandRandom
+{
+	template <typename TreeNode, typename RandomGen>
+	static uint pick(TreeNode const &node, RandomGen &rng)
+	{
+		return node.random_unplayed_move(rng);
+	}
+};
+
+// simulation: play uniformly random moves until the game ends.
+struct RandomPlayout
+{
+	template <typename Game, typename RandomGen>
+	static WinState playout(Game const &state, RandomGen &rng)
+	{
+		return random_playout(state, rng);
+	}
+};
+
+// backpropagation: add the result of the game to every edge of the path.
+struct BackpropResult
+{
+	// plies is the number of edges from the node to the end of the path.
+	static float delta(WinState winner, uint /*plies*/)
+	{
+		return winner;
+	}
+};
+
+// rule for stopping a search before its n_rollouts are done, once the
+// move to play, the most tried root move, is unlikely to change.
+// the default never stops early.
+struct EarlyStop
+{
+	// stop once no other root move could get as many tries as the most
+	// tried one, even if it got all of the remaining rollouts.
+	// never changes the move played.
+	bool uncatchable = false;
+	// if positive, also stop once the mean result of the most tried move
+	// is this many standard errors above that of every other move,
+	// taking the variance of a result in [-1, 1] to be its bound of 1.
+	float confidence = 0.0f;
+	// the rule is checked every this many rollouts, at least 1.
+	size_t check_every = 256;
+
+	bool enabled() const
+	{
+		return uncatchable || confidence > 0.0f;
+	}
+
+	// a move with best_tries tries stays ahead of one with other_tries.
+	bool is_ahead(float best_tries, float other_tries, size_t n_left) const
+	{
+		return uncatchable && other_tries + float(n_left) < best_tries;
+	}
+
+	// the confidence bounds of the mean results of two moves are apart.
+	// wins are from the view of the player to move.
+	bool is_better(float best_wins, float best_tries, float other_wins, float other_tries) const
+	{
+		if (confidence <= 0.0f || other_tries == 0.0f) return false;
+		return best_wins / best_tries - confidence / sqrtf(best_tries)
+			> other_wins / other_tries + confidence / sqrtf(other_tries);
+	}
+};
+
+// whether a node in NodeArena can have several parents, so that the
+// tree is a DAG. arenas that share nodes say so with
+// `static bool constexpr shares_nodes = true`.
+template <typename NodeArena, typename = void>
+struct shares_nodes : std::false_type {};
+
+template <typename NodeArena>
+struct shares_nodes<NodeArena, typename std::enable_if<NodeArena::shares_nodes>::type>
+	: std::true_type {};
+
+// stands in for the arena when following PointerLinks, which ignore it.
+struct NoArena {};
+
+// how a node refers to its children.
+
+// raw pointers, 8 bytes per move. works with any arena.
+struct PointerLinks
+{
+	template <typename T>
+	struct Link
+	{
+		T *p = nullptr;
+
+		bool empty() const { return p == nullptr; }
+
+		template <typename NodeArena>
+		T *get(NodeArena const &) const { return p; }
+
+		template <typename NodeArena>
+		void set(T *node, NodeArena const &) { p = node; }
+	};
+};
+
+// 32-bit indices into the arena, 4 bytes per move.
+// the tree holds no pointers, so its arena can be relocated or written out
+// and read back as is. needs an arena that numbers its objects
+// with at() and index_of(), i.e. MmapArena.
+struct IndexLinks
+{
+	template <typename T>
+	struct Link
+	{
+		// index + 1, so that zero-initialized links are empty.
+		uint32_t i = 0;
+
+		bool empty() const { return i == 0; }
+
+		template <typename NodeArena>
+		T *get(NodeArena const &arena) const
+		{
+			return i == 0 ? nullptr : arena.at(i - 1);
+		}
+
+		template <typename NodeArena>
+		void set(T *node, NodeArena const &arena)
+		{
+			i = (node == nullptr) ? 0 : arena.index_of(node) + 1;
+		}
+	};
+};
+
+template <typename Game, typename Select = UCB1<>, typename Expand = ExpandRandom,
+          typename Simulate = RandomPlayout, typename Backprop = BackpropResult,
+          typename Links = PointerLinks>
+class Search;
+
+// methods that follow child links take the arena holding the tree.
+// with the default PointerLinks, overloads without the arena are provided.
+// rollouts descend the tree by the Select policy, see selection.hpp.
+template <typename Game, typename Links = PointerLinks, typename Select = UCB1<>>
+class Node : private Select::template Stats<Game>
+{
+	// a base class, so that the empty statistics of most policies
+	// take no space in the node.
+	using Stats = typename Select::template Stats<Game>;
+
 public:
-	Node(Game &&state) : state(state) {}
+	Node(Game &&state) : state(state)
+	{
+		_init_valid(has_valid_moves_mask<Game>());
+		unexplored = valid;
+		n_unexplored = uint16_t(_count_unexplored());
+		result = WinState(this->state.winner());
+		proven = result;
+	}
+
 	Game state;
 
+	// the default arena. methods that allocate accept any arena type
+	// with the same alloc() interface, e.g. MmapArena.
 	using MyArena = Arena<Node>;
 
-	Node *clone(MyArena &arena) const
+	// copy the subtree from arena `from` into arena `to`.
+	// if `from` shares nodes between parents, as a TranspositionArena
+	// does, a node reached by several paths is copied once, so the copy
+	// keeps the sharing. trees skip the bookkeeping.
+	template <typename FromArena, typename ToArena>
+	Node *clone(FromArena const &from, ToArena &to) const
 	{
-		Node *node = arena.alloc(state);
-		*node = *this;
-		for (Node * &p : node->children) {
-			if (p != nullptr) {
-				p = p->clone(arena);
-			}
-		}
-		return node;
+		std::unordered_map<Node const *, Node *> copies;
+		return _clone(from, to, shares_nodes<FromArena>::value ? &copies : nullptr);
+	}
+
+	template <typename NodeArena>
+	Node *clone(NodeArena &arena) const
+	{
+		return clone(NoArena(), arena);
+	}
+
+	// state.winner(), computed once when the node is built.
+	WinState winner() const
+	{
+		return result;
 	}
 
 	bool is_leaf() const
 	{
-		return state.winner() != NONE;
+		return result != NONE;
+	}
+
+	// the result of the game from this state under perfect play,
+	// if the search has proven it, else NONE. see Search::prove().
+	WinState proven_value() const
+	{
+		return proven;
+	}
+
+	bool is_solved() const
+	{
+		return proven != NONE;
 	}
 
 	bool is_move_explored(uint move) const
 	{
-		return children[move] != nullptr;
+		return !children[move].empty();
+	}
+
+	template <typename NodeArena>
+	Node *child(uint move, NodeArena const &arena) const
+	{
+		return children[move].get(arena);
 	}
 
 	Node *child(uint move) const
 	{
-		return children[move];
+		return child(move, NoArena());
 	}
 
-	// do a rollout according to the UCT exploration strategy.
-	template <typename RandomGen>
-	WinState ucb_rollout(RandomGen &rng, MyArena &arena)
+	// allocate the child node for an unexplored move.
+	template <typename NodeArena>
+	Node *expand(uint move, NodeArena &arena)
 	{
-		WinState winner = state.winner();
-		if (winner != NONE) return winner;
+		assert(children[move].empty());
+		Node *node = arena.alloc(state.move(move));
+		children[move].set(node, arena);
+		if (node->result == (state.player_turn() == 0 ? WIN : LOSS)) {
+			winning[move / 64] |= uint64_t(1) << (move % 64);
+		}
+		return node;
+	}
 
-		// random_rollout updates counts
-		if (n_unplayed_moves() > 0) return random_rollout(rng, arena);
+	// add the edge statistics of another tree rooted at the same state.
+	// children we have not explored are adopted from the other tree,
+	// so it must outlive this node.
+	void merge(Node const &other)
+	{
+		static_assert(std::is_same<Links, PointerLinks>::value,
+		              "children can only be adopted across arenas by pointer");
+		assert(other.state.player_turn() == state.player_turn());
+		tot_tries += other.tot_tries;
+		_stats().merge(other._stats());
+		for (uint w = 0; w < unexplored.size(); ++w) {
+			unexplored[w] &= other.unexplored[w];
+			winning[w] |= other.winning[w];
+			losing[w] |= other.losing[w];
+			solved[w] |= other.solved[w];
+		}
+		if (proven == NONE) {
+			proven = other.proven;
+		}
+		n_unexplored = uint16_t(_count_unexplored());
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			tries[i] += other.tries[i];
+			wins[i] += other.wins[i];
+			if (children[i].empty()) {
+				children[i] = other.children[i];
+			}
+		}
+	}
 
-		// UCB policy
-		uint const player = state.player_turn();
-		uint const move = ucb_move();
-		assert(children[move] != nullptr);
-		winner = children[move]->ucb_rollout(rng, arena);
-		_update(move, winner);
-		return winner;
+	// free the subtree below move and give its nodes back to the arena.
+	// the edge statistics are kept, and the child is expanded again
+	// when the move is selected later.
+	template <typename NodeArena>
+	void prune(uint move, NodeArena &arena)
+	{
+		std::vector<Node *> stack;
+		_prune(move, arena, stack);
 	}
 
-	// do a random rollout until a game end state is reached.
-	// aka "simulation" in the UCT paper.
-	template <typename RandomGen>
-	WinState random_rollout(RandomGen &rng, MyArena &arena)
+	// prune the least-visited subtrees below this node
+	// until the arena holds at most max_nodes nodes.
+	template <typename NodeArena>
+	void prune_least_visited(NodeArena &arena, size_t max_nodes)
 	{
-		WinState winner = state.winner();
-		if (winner != NONE) {
-			tot_tries = 1.0f;
-			return winner;
+		struct Edge { Node *parent; uint move; float tries; uint depth; };
+		std::vector<Edge> edges;
+		std::vector<Edge> stack = {{this, 0, 0.0f, 0}};
+		while (!stack.empty()) {
+			Node *node = stack.back().parent;
+			uint const depth = stack.back().depth;
+			stack.pop_back();
+			for (uint i = 0; i < Game::n_moves(); ++i) {
+				if (!node->children[i].empty()) {
+					edges.push_back({node, i, node->tries[i], depth});
+					stack.push_back({node->child(i, arena), 0, 0.0f, depth + 1});
+				}
+			}
 		}
+		// an edge has at most as many tries as the edges above it,
+		// so deeper-first among ties means a subtree is never pruned
+		// after its root, and we never touch an already freed node.
+		std::sort(edges.begin(), edges.end(), [](Edge const &a, Edge const &b) {
+			return a.tries < b.tries || (a.tries == b.tries && a.depth > b.depth);
+		});
+		std::vector<Node *> subtree;
+		for (Edge const &e : edges) {
+			if (arena.size() <= max_nodes) break;
+			e.parent->_prune(e.move, arena, subtree);
+		}
+	}
 
-		uint move = random_unplayed_move(rng);
-		auto node = arena.alloc(state.move(move));
-		winner = node->random_rollout(rng, arena);
-		assert(children[move] == nullptr);
-		children[move] = std::move(node);
-		_update(move, winner);
-		return winner;
+	// do a rollout according to the UCT exploration strategy:
+	// descend by the Select policy until a node with unexplored moves,
+	// add one child there and do a random playout from it.
+	// if the arena already holds max_nodes nodes, no child is added
+	// and the playout starts from the last node of the tree instead.
+	// same as Search with the default stages, see below.
+	template <typename RandomGen, typename NodeArena>
+	WinState ucb_rollout(RandomGen &rng, NodeArena &arena,
+	                     size_t max_nodes = std::numeric_limits<size_t>::max())
+	{
+		return Search<Game, Select, ExpandRandom, RandomPlayout, BackpropResult, Links>
+			::rollout(this, rng, arena, max_nodes);
 	}
 
-	// compute the number of moves that have not been explored yet.
-	inline uint n_unplayed_moves() const
+	// the number of moves that have not been explored yet.
+	uint n_unplayed_moves() const
 	{
-		uint count = 0;
-		for (uint i = 0; i < Game::n_moves(); ++i) {
-			count += (tries[i] == 0 && state.is_valid(i));
-		}
-		return count;
+		return n_unexplored;
+	}
+
+	// true once every valid move has been tried.
+	bool is_fully_expanded() const
+	{
+		return n_unexplored == 0;
 	}
 
-	// TODO factor common of random_move and random_unplayed_move
 	template <typename RandomGen>
 	uint random_move(RandomGen &rng) const
 	{
-		uint n = state.n_valid_moves();
-		std::uniform_int_distribution<uint> dist(1, n);
-		uint imove = dist(rng);
-		uint count = 0;
-		for (uint i = 0; i < Game::n_moves(); ++i) {
-			count += state.is_valid(i);
-			if (count == imove) {
-				return i;
-			}
-		}
-		assert(false);
-		return 0xFFFFFFFF;
+		return mcts::random_move(state, rng);
 	}
 
 	// find a random move that has not been played yet.
@@ -173,15 +487,14 @@ public:
 	{
 		uint n = n_unplayed_moves();
 		assert(n > 0);
-		std::uniform_int_distribution<uint> dist(1, n);
-		uint imove = dist(rng);
-		// TODO can we use a std::algorithm here?
-		uint count = 0;
-		for (uint i = 0; i < Game::n_moves(); ++i) {
-			count += (tries[i] == 0 && state.is_valid(i));
-			if (count == imove) {
-				return i;
+		std::uniform_int_distribution<uint> dist(0, n - 1);
+		uint k = dist(rng);
+		for (uint w = 0; w < unexplored.size(); ++w) {
+			uint const count = popcount(unexplored[w]);
+			if (k < count) {
+				return 64 * w + select_bit(unexplored[w], k);
 			}
+			k -= count;
 		}
 		assert(false);
 		return 0xFFFFFFFF;
@@ -190,41 +503,107 @@ public:
 	// move according to the UCB (upper confidence bound) exploration strategy
 	uint ucb_move() const
 	{
+		return ucb_move(NoArena());
+	}
+
+	template <typename NodeArena>
+	uint ucb_move(NodeArena const &) const
+	{
+		// a proven win may be found before all moves are tried.
+		uint const win = _winning_move();
+		if (win != 0xFFFFFFFF) return win;
 		assert(n_unplayed_moves() == 0);
 
-		uint player = state.player_turn();
-		float const flip = (player == 0) ? 1.0f : -1.0f;
-		auto ucb = [this, flip](uint move) {
-			float const mean = flip * wins[move] / tries[move];
-			return mean + sqrtf(2.0f * fastlog(tot_tries+1e-4f) / tries[move]);
-		};
+		auto const moves = _valid_except(losing);
+		uint const i_max = ucb_argmax(tries.data(), wins.data(), moves.data(),
+		                              Game::n_moves(), _flip(), explore_term(tot_tries));
+		assert(i_max != 0xFFFFFFFF);
+		return i_max;
+	}
+
+	// move to descend into during a rollout, according to the Select policy.
+	// the results of proven moves are known, so they are skipped
+	// while there are others left to prove.
+	template <typename RandomGen, typename NodeArena>
+	uint select_move(RandomGen &rng, NodeArena const &) const
+	{
+		// a proven win may be found before all moves are tried.
+		uint const win = _winning_move();
+		if (win != 0xFFFFFFFF) return win;
+		assert(is_fully_expanded());
+		return _select(rng, _valid_except(solved));
+	}
 
-		float ucb_max = -std::numeric_limits<float>::infinity();
+	// the move to play if the search stopped now: a proven win, else
+	// the most tried move not proven to lose. a proven tie is taken
+	// over a more tried move whose results so far are losing.
+	// can be called between any two rollouts, but not during one.
+	template <typename NodeArena>
+	uint best_move(NodeArena const &) const
+	{
+		uint const win = _winning_move();
+		if (win != 0xFFFFFFFF) return win;
+
+		auto const moves = _valid_except(losing);
 		uint i_max = 0xFFFFFFFF;
+		uint i_tie = 0xFFFFFFFF;
 		for (uint i = 0; i < Game::n_moves(); ++i) {
-			if (!state.is_valid(i)) continue;
-			// exit early if one of our children is a winning leaf state.
-			if (player == 0 && children[i]->state.winner() == WIN) {
-				return i;
-			}
-			if (player == 1 && children[i]->state.winner() == LOSS) {
-				return i;
-			}
-			float ucb_i = ucb(i);
-			if (ucb_i > ucb_max) {
-				ucb_max = ucb_i;
-				i_max = i;
-			}
+			if (!mask_bit(moves.data(), i)) continue;
+			if (i_max == 0xFFFFFFFF || tries[i] > tries[i_max]) i_max = i;
+			if (mask_bit(solved.data(), i) && !mask_bit(losing.data(), i)) i_tie = i;
 		}
 		assert(i_max != 0xFFFFFFFF);
+		if (i_tie != 0xFFFFFFFF && !mask_bit(solved.data(), i_max) && _flip() * wins[i_max] < 0.0f) {
+			return i_tie;
+		}
 		return i_max;
 	}
 
+	// whether search can stop with n_left rollouts to go, by rule:
+	// the root is solved, or best_move() is the most tried move and
+	// the rule holds for it against every other move not proven to lose.
+	bool is_decided(size_t n_left, EarlyStop const &rule) const
+	{
+		if (is_solved()) return true;
+		uint const best = best_move(NoArena());
+		auto const moves = _valid_except(losing);
+		bool ahead = true, better = true;
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			if (i == best || !mask_bit(moves.data(), i)) continue;
+			if (tries[i] > tries[best]) return false;
+			ahead = ahead && rule.is_ahead(tries[best], tries[i], n_left);
+			better = better && rule.is_better(_flip() * wins[best], tries[best],
+			                                  _flip() * wins[i], tries[i]);
+		}
+		return ahead || better;
+	}
+
 private:
 	float tot_tries = 0.0f;
-	std::array<Node *, Game::n_moves()> children = {};
+	// bits set in unexplored, kept up to date by _update.
+	// small, so that it shares padding with result.
+	uint16_t n_unexplored = 0;
+	int8_t result = NONE;
+	int8_t proven = NONE;
+	static_assert(Game::n_moves() <= 0xFFFF, "n_unexplored counts up to 65535 moves");
+	std::array<typename Links::template Link<Node>, Game::n_moves()> children = {};
+	// edge statistics as packed float arrays, so that selection
+	// can evaluate many edges per instruction.
 	std::array<float, Game::n_moves()> tries = {};
 	std::array<float, Game::n_moves()> wins = {};
+	// bit i is set if move i is valid.
+	std::array<uint64_t, (Game::n_moves() + 63) / 64> valid = {};
+	// bit i is set if move i is valid and has no tries yet.
+	std::array<uint64_t, (Game::n_moves() + 63) / 64> unexplored = {};
+	// bit i is set if the child of move i is proven to win for the
+	// player to move, to lose, or to have any value, so selection
+	// needs no look at the children.
+	std::array<uint64_t, (Game::n_moves() + 63) / 64> winning = {};
+	std::array<uint64_t, (Game::n_moves() + 63) / 64> losing = {};
+	std::array<uint64_t, (Game::n_moves() + 63) / 64> solved = {};
+
+	template <typename, typename, typename, typename, typename, typename>
+	friend class Search;
 
 	void _update(uint move, float delta)
 	{
@@ -232,17 +611,447 @@ private:
 		++tries[move];
 		++tot_tries;
 		wins[move] += delta;
+		_stats().update(move, delta);
+		uint64_t const bit = uint64_t(1) << (move % 64);
+		n_unexplored -= (unexplored[move / 64] & bit) != 0;
+		unexplored[move / 64] &= ~bit;
+	}
+
+	uint _count_unexplored() const
+	{
+		uint count = 0;
+		for (uint64_t word : unexplored) {
+			count += popcount(word);
+		}
+		return count;
+	}
+
+	void _init_valid(std::true_type /*has mask*/)
+	{
+		static_assert(Game::n_moves() <= 64, "valid_moves_mask() holds up to 64 moves");
+		valid[0] = state.valid_moves_mask();
+	}
+
+	void _init_valid(std::false_type /*has mask*/)
+	{
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			if (state.is_valid(i)) {
+				valid[i / 64] |= uint64_t(1) << (i % 64);
+			}
+		}
+	}
+
+	// prune(), iterative so that deep trees cannot overflow the stack.
+	// stack is scratch space, passed in so that its capacity is reused.
+	template <typename NodeArena>
+	void _prune(uint move, NodeArena &arena, std::vector<Node *> &stack)
+	{
+		assert(!children[move].empty());
+		stack.assign(1, child(move, arena));
+		children[move].set(nullptr, arena);
+		while (!stack.empty()) {
+			Node *node = stack.back();
+			stack.pop_back();
+			for (uint i = 0; i < Game::n_moves(); ++i) {
+				if (!node->children[i].empty()) {
+					stack.push_back(node->child(i, arena));
+				}
+			}
+			arena.free(node);
+		}
+	}
+
+	// copies maps the nodes copied so far to their copies, or is null.
+	template <typename FromArena, typename ToArena>
+	Node *_clone(FromArena const &from, ToArena &to,
+	             std::unordered_map<Node const *, Node *> *copies) const
+	{
+		if (copies != nullptr) {
+			auto const found = copies->find(this);
+			if (found != copies->end()) return found->second;
+		}
+		Node *node = to.alloc(Game(state));
+		*node = *this;
+		if (copies != nullptr) {
+			copies->emplace(this, node);
+		}
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			Node const *c = child(i, from);
+			if (c != nullptr) {
+				node->children[i].set(c->_clone(from, to, copies), to);
+			}
+		}
+		return node;
+	}
+
+	Stats &_stats() { return *this; }
+	Stats const &_stats() const { return *this; }
+
+	float _flip() const
+	{
+		return (state.player_turn() == 0) ? 1.0f : -1.0f;
+	}
+
+	// the valid moves not in skip, or all valid moves if that leaves none.
+	std::array<uint64_t, (Game::n_moves() + 63) / 64>
+	_valid_except(std::array<uint64_t, (Game::n_moves() + 63) / 64> const &skip) const
+	{
+		std::array<uint64_t, (Game::n_moves() + 63) / 64> moves;
+		uint64_t any = 0;
+		for (uint w = 0; w < moves.size(); ++w) {
+			moves[w] = valid[w] & ~skip[w];
+			any |= moves[w];
+		}
+		return any != 0 ? moves : valid;
+	}
+
+	template <typename RandomGen>
+	uint _select(RandomGen &rng, std::array<uint64_t, (Game::n_moves() + 63) / 64> const &moves) const
+	{
+		EdgeStats const edges = {tries.data(), wins.data(), moves.data(),
+		                         Game::n_moves(), tot_tries, _flip()};
+		uint const i_max = Select::select(state, edges, _stats(), rng);
+		assert(i_max != 0xFFFFFFFF);
+		return i_max;
+	}
+
+	// the child of move is proven to have value. returns true if that
+	// proves this node too: one winning move is enough for the player
+	// to move, else all of its moves must be proven.
+	bool _prove(uint move, WinState value)
+	{
+		if (proven != NONE) return false;
+		WinState const good = (state.player_turn() == 0) ? WIN : LOSS;
+		uint64_t const bit = uint64_t(1) << (move % 64);
+		solved[move / 64] |= bit;
+		if (value == good) {
+			winning[move / 64] |= bit;
+			proven = good;
+			return true;
+		}
+		if (value != TIE) {
+			losing[move / 64] |= bit;
+		}
+		bool tie = false;
+		for (uint w = 0; w < valid.size(); ++w) {
+			if ((valid[w] & ~solved[w]) != 0) return false;
+			tie |= (valid[w] & ~losing[w]) != 0;
+		}
+		proven = tie ? TIE : -good;
+		return true;
+	}
+
+	// a move proven to win, or 0xFFFFFFFF if none.
+	uint _winning_move() const
+	{
+		for (uint w = 0; w < winning.size(); ++w) {
+			if (winning[w] != 0) {
+				return 64 * w + uint(__builtin_ctzll(winning[w]));
+			}
+		}
+		return 0xFFFFFFFF;
 	}
 };
 
-// play an entire game between the MCTS agent and random agent.
+// what a search does once its tree reaches the memory budget.
+enum class OnBudget
+{
+	// keep the tree as it is and start playouts from its leaves.
+	STOP_EXPANDING,
+	// free the least-visited subtrees and keep expanding.
+	PRUNE,
+};
 
-template <typename Game, typename RandomGen>
+// bound on the memory used by the nodes of a search tree.
+// what to do at the bound is part of the type, so that PRUNE is
+// rejected at compile time for arenas that cannot free single nodes.
+template <OnBudget On = OnBudget::STOP_EXPANDING>
+struct MemoryBudget
+{
+	static OnBudget constexpr on_budget = On;
+	size_t bytes = std::numeric_limits<size_t>::max();
+	// PRUNE frees nodes until this fraction of the budget is used,
+	// so that pruning does not run again on the very next rollout.
+	float prune_to = 0.75f;
+};
+
+// whether NodeArena has a free() for single nodes.
+template <typename NodeArena, typename = void>
+struct can_free_nodes : std::false_type {};
+
+template <typename NodeArena>
+struct can_free_nodes<NodeArena, decltype(std::declval<NodeArena &>().free(
+	std::declval<typename NodeArena::value_type *>()))> : std::true_type {};
+
+// keep the tree within the budget before a rollout.
+// STOP_EXPANDING is handled by the rollout, which adds no node.
+template <typename TreeNode, typename NodeArena>
+void enforce_budget(TreeNode *, NodeArena &, MemoryBudget<OnBudget::STOP_EXPANDING> const &, size_t)
+{
+}
+
+template <typename TreeNode, typename NodeArena>
+void enforce_budget(TreeNode *root, NodeArena &arena,
+                    MemoryBudget<OnBudget::PRUNE> const &budget, size_t max_nodes)
+{
+	static_assert(can_free_nodes<NodeArena>::value,
+	              "OnBudget::PRUNE needs an arena that can free single nodes");
+	if (arena.size() >= max_nodes) {
+		root->prune_least_visited(arena, size_t(budget.prune_to * max_nodes));
+	}
+}
+
+// the loop of search(), with rollout(max_nodes) doing one rollout
+// from root. shared by search() and Search::run.
+template <typename TreeNode, typename NodeArena, OnBudget On, typename Rollout>
+size_t search_with(TreeNode *root, NodeArena &arena, size_t n_rollouts,
+                   MemoryBudget<On> const &budget, EarlyStop const &stop, Rollout &&rollout)
+{
+	assert(!stop.enabled() || stop.check_every > 0);
+	size_t const max_nodes = budget.bytes / sizeof(*root);
+	for (size_t i = 0; i < n_rollouts; ++i) {
+		if (root->is_solved()) return i;
+		if (stop.enabled() && i % stop.check_every == 0 && i > 0
+		    && root->is_decided(n_rollouts - i, stop)) {
+			return i;
+		}
+		enforce_budget(root, arena, budget, max_nodes);
+		rollout(max_nodes);
+	}
+	return n_rollouts;
+}
+
+// do n_rollouts rollouts from root, keeping the nodes of the tree
+// within the budget. without a budget, the tree grows without bound.
+// stops early once the root is solved or the stop rule holds, and
+// returns the number of rollouts done.
+// works for any tree node type with the interface of Node.
+template <typename TreeNode, typename RandomGen, typename NodeArena,
+          OnBudget On = OnBudget::STOP_EXPANDING>
+size_t search(TreeNode *root, RandomGen &rng, NodeArena &arena,
+              size_t n_rollouts, MemoryBudget<On> const &budget = MemoryBudget<On>(),
+              EarlyStop const &stop = EarlyStop())
+{
+	return search_with(root, arena, n_rollouts, budget, stop, [&](size_t max_nodes) {
+		root->ucb_rollout(rng, arena, max_nodes);
+	});
+}
+
+// do rollouts from root until deadline or until the root is solved,
+// and return the number done. the clock is read every check_every > 0
+// rollouts, so the search may overrun the deadline by that many.
+// best_move() gives the move to play whenever it returns, and calling
+// it again with a later deadline continues the same search.
+template <typename TreeNode, typename RandomGen, typename NodeArena,
+          typename Clock, typename Duration, OnBudget On = OnBudget::STOP_EXPANDING>
+size_t search_until(TreeNode *root, RandomGen &rng, NodeArena &arena,
+                    std::chrono::time_point<Clock, Duration> const &deadline,
+                    MemoryBudget<On> const &budget = MemoryBudget<On>(), size_t check_every = 64)
+{
+	assert(check_every > 0);
+	size_t n = 0;
+	while (!root->is_solved() && Clock::now() < deadline) {
+		n += search(root, rng, arena, check_every, budget);
+	}
+	return n;
+}
+
+/*
+Search driver built from one static policy per MCTS stage:
+- Select: which tried edge to descend into (selection.hpp),
+- Expand: which untried move to add to the tree,
+- Simulate: how to play the game out from the new leaf,
+- Backprop: what to add to the edges of the path.
+
+Each stage is also available on its own, so that it can be profiled
+or replaced without touching the others. All calls are static, so a
+custom playout is inlined into the rollout loop.
+
+NOTE: this is not real Concepts code!
+
+concept Expand
+{
+	// an untried move of node, i.e. node.n_unplayed_moves() > 0.
+	template <typename TreeNode, typename RandomGen>
+	static uint pick(TreeNode const &node, RandomGen &rng);
+};
+
+concept Simulate
+{
+	// result of the game continued from state.
+	template <typename Game, typename RandomGen>
+	static WinState playout(Game const &state, RandomGen &rng);
+};
+
+concept Backprop
+{
+	// what to add to the wins of an edge, plies edges above the end
+	// of the path, when the rollout ended with winner.
+	static float delta(WinState winner, uint plies);
+};
+*/
+template <typename Game, typename Select, typename Expand,
+          typename Simulate, typename Backprop, typename Links>
+class Search
+{
+public:
+	using TreeNode = Node<Game, Links, Select>;
+
+	// an edge taken from node.
+	struct Step
+	{
+		TreeNode *node;
+		uint move;
+	};
+	using Path = std::array<Step, Game::max_depth()>;
+
+	// one rollout from root, as in Node::ucb_rollout.
+	template <typename RandomGen, typename NodeArena>
+	static WinState rollout(TreeNode *root, RandomGen &rng, NodeArena &arena,
+	                        size_t max_nodes = std::numeric_limits<size_t>::max())
+	{
+		Path path;
+		uint const depth = select(root, rng, arena, path);
+		WinState winner;
+		if (depth == 0) {
+			winner = root->proven_value();
+		} else if (!path[depth - 1].node->is_move_explored(path[depth - 1].move)) {
+			winner = simulate(expand(path[depth - 1], arena, max_nodes), rng);
+		} else {
+			// proven nodes are not played out again.
+			winner = path[depth - 1].node->child(path[depth - 1].move, arena)->proven_value();
+		}
+		backprop(path, depth, winner);
+		prove(path, depth, arena);
+		return winner;
+	}
+
+	// do n_rollouts rollouts from root within the budget, as search().
+	// stops early once the root is solved or the stop rule holds,
+	// and returns the number done.
+	template <typename RandomGen, typename NodeArena, OnBudget On = OnBudget::STOP_EXPANDING>
+	static size_t run(TreeNode *root, RandomGen &rng, NodeArena &arena,
+	                  size_t n_rollouts, MemoryBudget<On> const &budget = MemoryBudget<On>(),
+	                  EarlyStop const &stop = EarlyStop())
+	{
+		return search_with(root, arena, n_rollouts, budget, stop, [&](size_t max_nodes) {
+			rollout(root, rng, arena, max_nodes);
+		});
+	}
+
+	// selection: descend from root and record the edges taken in path.
+	// iterative, so deep games cannot overflow the stack.
+	// returns the length of the path. the path ends either with an edge
+	// whose child is not in the tree (an untried move picked by Expand,
+	// or one whose subtree was pruned or never added because of the
+	// memory budget), or at a solved node, e.g. a terminal one.
+	template <typename RandomGen, typename NodeArena>
+	static uint select(TreeNode *root, RandomGen &rng, NodeArena const &arena, Path &path)
+	{
+		uint depth = 0;
+		TreeNode *node = root;
+		while (!node->is_solved()) {
+			assert(depth < path.size());
+			if (!node->is_fully_expanded()) {
+				path[depth++] = {node, Expand::pick(*node, rng)};
+				break;
+			}
+			uint const move = node->select_move(rng, arena);
+			path[depth++] = {node, move};
+			if (!node->is_move_explored(move)) break;
+			node = node->child(move, arena);
+		}
+		return depth;
+	}
+
+	// expansion: add the child below the last edge of the path to the
+	// tree, if the arena holds fewer than max_nodes nodes.
+	// returns the state to simulate from.
+	template <typename NodeArena>
+	static Game expand(Step const &leaf, NodeArena &arena, size_t max_nodes)
+	{
+		if (arena.size() < max_nodes) {
+			return leaf.node->expand(leaf.move, arena)->state;
+		}
+		return leaf.node->state.move(leaf.move);
+	}
+
+	// simulation: the result of the game continued from state.
+	template <typename RandomGen>
+	static WinState simulate(Game const &state, RandomGen &rng)
+	{
+		return Simulate::playout(state, rng);
+	}
+
+	// MCTS-Solver (Winands et al., "Monte-Carlo Tree Search Solver",
+	// Computers and Games 2008): back up proven results along the path.
+	// a node is proven once one of its moves is proven to win for the
+	// player to move, or once all of its moves are proven. rollouts
+	// descend into unproven moves only while there are any, best_move()
+	// and ucb_move() skip the moves proven to lose, and search stops
+	// once the root is proven.
+	template <typename NodeArena>
+	static void prove(Path const &path, uint depth, NodeArena const &arena)
+	{
+		for (uint i = depth; i-- > 0;) {
+			TreeNode const *child = path[i].node->child(path[i].move, arena);
+			if (child == nullptr || !child->is_solved()) return;
+			if (!path[i].node->_prove(path[i].move, child->proven_value())) return;
+		}
+	}
+
+	// backpropagation: update the statistics of the edges of the path.
+	static void backprop(Path const &path, uint depth, WinState winner)
+	{
+		for (uint i = 0; i < depth; ++i) {
+			path[i].node->_update(path[i].move, Backprop::delta(winner, depth - i));
+		}
+	}
+};
+
+// make the child reached by move the new root of the tree.
+// its subtree is copied into a fresh arena which replaces the old one,
+// so the siblings and ancestors are freed but the statistics
+// gathered under the played move are kept.
+// all pointers into the old tree are invalidated.
+template <typename TreeNode, typename NodeArena>
+TreeNode *promote(TreeNode const *root, uint move, NodeArena &arena)
+{
+	TreeNode const *child = root->child(move, arena);
+	assert(child != nullptr);
+	NodeArena fresh;
+	TreeNode *new_root = child->clone(arena, fresh);
+	arena = std::move(fresh);
+	return new_root;
+}
+
+// same, but the subtree is copied into spare, which is then swapped with
+// arena. the old arena is reset into spare, so that alternating between
+// the two arenas reuses their blocks instead of allocating new ones.
+template <typename TreeNode, typename NodeArena>
+TreeNode *promote(TreeNode const *root, uint move,
+                  NodeArena &arena, NodeArena &spare)
+{
+	TreeNode const *child = root->child(move, arena);
+	assert(child != nullptr);
+	spare.reset();
+	TreeNode *new_root = child->clone(arena, spare);
+	std::swap(arena, spare);
+	spare.reset();
+	return new_root;
+}
+
+// play an entire game between the MCTS agent and random agent.
+// the MCTS agent calls think(tree, arena) to search before each move,
+// and then plays best_move().
+// the node type, and so its Links, is the one held by NodeArena.
+template <typename Game, typename RandomGen, typename NodeArena = Arena<Node<Game>>,
+          typename Think>
 std::pair<std::vector<Game>, std::vector<uint>>
-play_vs_random(RandomGen &prng, size_t n_rollouts)
+play_vs_random_with(RandomGen &prng, Think &&think)
 {
-	Arena<Node<Game>> arena;
-	Node<Game> *tree = arena.alloc(Game());
+	NodeArena arena, spare;
+	typename NodeArena::value_type *tree = arena.alloc(Game());
 	std::vector<Game> state_history = { tree->state, };
 	std::vector<uint> move_history;
 
@@ -254,24 +1063,53 @@ play_vs_random(RandomGen &prng, size_t n_rollouts)
 		uint move;
 		if (player == 0) {
 			// execute rollouts for MCTS policy
-			for (int i = 0; i < n_rollouts; ++i) {
-				tree->ucb_rollout(prng, arena);
-			}
-			move = tree->ucb_move();
+			think(tree, arena);
+			move = tree->best_move(arena);
 		} else if (player == 1) {
 			// execute opponent random policy
 			move = tree->random_move(prng);
-			// this should actually be valid. TODO: handle case
-			assert(tree->is_move_explored(move));
 		} else {
 			assert(false);
 		}
+		// only one node is added per rollout, and a memory budget may
+		// have pruned or never added the child, so either player
+		// may pick a move without one.
+		if (!tree->is_move_explored(move)) {
+			tree->expand(move, arena);
+		}
 		move_history.push_back(move);
-		tree = tree->child(move);
+		tree = promote(tree, move, arena, spare);
 		state_history.push_back(tree->state);
 	}
 
 	return std::make_pair(std::move(state_history), std::move(move_history));
 }
 
+// with up to n_rollouts per move.
+template <typename Game, typename RandomGen, typename NodeArena = Arena<Node<Game>>,
+          OnBudget On = OnBudget::STOP_EXPANDING>
+std::pair<std::vector<Game>, std::vector<uint>>
+play_vs_random(RandomGen &prng, size_t n_rollouts,
+               MemoryBudget<On> const &budget = MemoryBudget<On>(),
+               EarlyStop const &stop = EarlyStop())
+{
+	return play_vs_random_with<Game, RandomGen, NodeArena>(prng,
+		[&](typename NodeArena::value_type *tree, NodeArena &arena) {
+			search(tree, prng, arena, n_rollouts, budget, stop);
+		});
+}
+
+// with a wall-clock time per move.
+template <typename Game, typename RandomGen, typename NodeArena = Arena<Node<Game>>,
+          typename Rep, typename Period, OnBudget On = OnBudget::STOP_EXPANDING>
+std::pair<std::vector<Game>, std::vector<uint>>
+play_vs_random(RandomGen &prng, std::chrono::duration<Rep, Period> time_per_move,
+               MemoryBudget<On> const &budget = MemoryBudget<On>())
+{
+	return play_vs_random_with<Game, RandomGen, NodeArena>(prng,
+		[&](typename NodeArena::value_type *tree, NodeArena &arena) {
+			search_until(tree, prng, arena, std::chrono::steady_clock::now() + time_per_move, budget);
+		});
+}
+
 } // namespace mcts
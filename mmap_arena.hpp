@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+// a one-type arena that bump-allocates from a single reserved range of
+// virtual memory. pages are only backed by physical memory when first
+// touched, so the reservation can be far larger than what is used.
+// it has the same interface as Arena and can replace it for any tree.
+//
+// backing the range with 2 MB huge pages instead of 4 kB ones means a big
+// tree spans far fewer TLB entries, so descending it misses the TLB less.
+// but first touching a huge page costs more, and for trees of a few
+// hundred MB that outweighs the TLB misses saved, so the default is
+// normal pages. ask for huge pages for multi-GB trees.
+
+enum class Pages
+{
+	NORMAL,
+	// ask the kernel to back the range with transparent huge pages.
+	TRANSPARENT_HUGE,
+	// explicit huge pages from the hugetlbfs pool. falls back to
+	// TRANSPARENT_HUGE if the pool is empty or not configured.
+	EXPLICIT_HUGE,
+};
+
+template <typename T>
+class MmapArena
+{
+public:
+	using value_type = T;
+
+	static size_t constexpr HUGE_PAGE = size_t(1) << 21;
+
+	// reserve room for capacity_bytes worth of objects.
+	// throws std::bad_alloc if the range cannot be mapped.
+	explicit MmapArena(size_t capacity_bytes = size_t(1) << 32,
+	                   Pages pages = Pages::NORMAL)
+	{
+		bytes = (capacity_bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+		int const prot = PROT_READ | PROT_WRITE;
+		int const flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+		void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if (pages == Pages::EXPLICIT_HUGE) {
+			p = mmap(nullptr, bytes, prot, flags | MAP_HUGETLB, -1, 0);
+		}
+#endif
+		if (p == MAP_FAILED) {
+			p = mmap(nullptr, bytes, prot, flags, -1, 0);
+			if (p == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+			if (pages != Pages::NORMAL) {
+				// only a hint: it is fine if the kernel does not support it.
+				madvise(p, bytes, MADV_HUGEPAGE);
+			}
+#endif
+		}
+		base = static_cast<T *>(p);
+		capacity = bytes / sizeof(T);
+	}
+
+	MmapArena(MmapArena const &) = delete;
+	MmapArena &operator=(MmapArena const &) = delete;
+
+	MmapArena(MmapArena &&other) noexcept
+		: base(other.base), used(other.used), capacity(other.capacity), bytes(other.bytes),
+		  free_objects(std::move(other.free_objects))
+	{
+		other.base = nullptr;
+		other.used = other.capacity = other.bytes = 0;
+	}
+
+	MmapArena &operator=(MmapArena &&other) noexcept
+	{
+		std::swap(base, other.base);
+		std::swap(used, other.used);
+		std::swap(capacity, other.capacity);
+		std::swap(bytes, other.bytes);
+		std::swap(free_objects, other.free_objects);
+		return *this;
+	}
+
+	~MmapArena()
+	{
+		if (base != nullptr) {
+			_destroy();
+			munmap(base, bytes);
+		}
+	}
+
+	// arguments are forwarded to T constructor.
+	// throws std::bad_alloc when the reserved range is full.
+	template <typename... Args> T *alloc(Args &&... args)
+	{
+		if (!free_objects.empty()) {
+			T *p = free_objects.back();
+			free_objects.pop_back();
+			p->~T();
+			return new (p) T(std::forward<Args>(args)...);
+		}
+		if (used == capacity) throw std::bad_alloc();
+		return new (base + used++) T(std::forward<Args>(args)...);
+	}
+
+	// give back an object for reuse by a later alloc().
+	// it is only destroyed when reused or when the arena is reset.
+	void free(T *p)
+	{
+		free_objects.push_back(p);
+	}
+
+	// destroy all objects but keep the pages mapped for reuse.
+	void reset()
+	{
+		_destroy();
+		used = 0;
+		free_objects.clear();
+	}
+
+	// destroy all objects and give the pages back to the kernel.
+	// the range stays reserved.
+	void clear()
+	{
+		reset();
+		madvise(base, bytes, MADV_DONTNEED);
+	}
+
+	// number of live objects.
+	size_t size() const
+	{
+		return used - free_objects.size();
+	}
+
+	// objects are numbered by their offset in the range, which stays
+	// valid if the whole range is copied elsewhere.
+	// IndexLinks stores index + 1 in 32 bits, so the reservation must
+	// hold fewer than 2^32 - 1 objects.
+	T *at(uint32_t i) const
+	{
+		assert(_fits_index());
+		assert(i < used);
+		return base + i;
+	}
+
+	uint32_t index_of(T const *p) const
+	{
+		assert(_fits_index());
+		assert(base <= p && p < base + used);
+		return uint32_t(p - base);
+	}
+
+private:
+	T *base = nullptr;
+	size_t used = 0;
+	size_t capacity = 0;
+	size_t bytes = 0;
+	std::vector<T *> free_objects;
+
+	bool _fits_index() const
+	{
+		return capacity < std::numeric_limits<uint32_t>::max();
+	}
+
+	void _destroy()
+	{
+		if (!std::is_trivially_destructible<T>::value) {
+			for (size_t i = 0; i < used; ++i) {
+				base[i].~T();
+			}
+		}
+	}
+};
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "mcts.hpp"
+
+/*
+Parallel variants of Monte Carlo Tree Search.
+
+"Root parallelization" runs N independent searches from the same root state,
+each with its own arena, tree and random generator, and merges the root edge
+statistics at the end.
+
+"Tree parallelization" has all threads descend one shared tree.
+Node statistics are atomics, and each thread adds a "virtual loss" to the
+edges on its path while its rollout is in flight, so that concurrent threads
+are steered into different subtrees instead of all following the same one.
+New children are published with compare-and-swap, so no thread ever locks.
+(Guillaume Chaslot et al., "Parallel Monte-Carlo Tree Search",
+Int'l Conference on Computers and Games, 2008.)
+*/
+
+namespace mcts
+{
+
+// search from the root state with n_threads independent trees and return
+// the move chosen from their merged root statistics.
+// n_rollouts is the total budget, split evenly between the threads.
+// seeds[i] seeds the random generator of thread i.
+template <typename Game, typename RandomGen = std::default_random_engine>
+uint root_parallel_search(uint n_threads, size_t n_rollouts,
+                          std::vector<uint> const &seeds, Game const &root = Game())
+{
+	assert(n_threads > 0);
+	assert(seeds.size() >= n_threads);
+
+	std::vector<Arena<Node<Game>>> arenas(n_threads);
+	std::vector<Node<Game> *> trees(n_threads);
+	std::vector<std::thread> threads;
+	threads.reserve(n_threads);
+
+	for (uint t = 0; t < n_threads; ++t) {
+		// spread the remainder of the budget over the first threads.
+		size_t const n = n_rollouts / n_threads + (t < n_rollouts % n_threads);
+		threads.emplace_back([&, t, n]() {
+			RandomGen prng(seeds[t]);
+			trees[t] = arenas[t].alloc(Game(root));
+			for (size_t i = 0; i < n; ++i) {
+				trees[t]->ucb_rollout(prng, arenas[t]);
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	// the merged root refers to children in the other trees' arenas,
+	// which stay alive until we return.
+	// its move is picked as by play_vs_random, which also works when
+	// some root moves were tried in none of the trees.
+	Node<Game> merged = *trees[0];
+	for (uint t = 1; t < n_threads; ++t) {
+		merged.merge(*trees[t]);
+	}
+	return merged.best_move(NoArena());
+}
+
+// std::atomic<float> has no fetch_add before C++20.
+static inline void atomic_add(std::atomic<float> &a, float x)
+{
+	float old = a.load(std::memory_order_relaxed);
+	while (!a.compare_exchange_weak(old, old + x, std::memory_order_relaxed)) {
+	}
+}
+
+// tree node that can be searched by many threads at once.
+// mirrors Node, but a move counts as explored as soon as its child exists,
+// since the edge statistics are only updated after the rollout returns.
+//
+// it deliberately stays on the design Node started from: a winner()
+// scan over the children during selection, UCB1 only, and no move masks,
+// unexplored count or proven values. those caches are plain fields that
+// Node updates in place, and keeping them consistent between threads
+// would need an atomic or a CAS loop for each. SharedNode is the
+// reference for tree parallelization, not its fast path.
+template <typename Game>
+class SharedNode
+{
+public:
+	SharedNode(Game &&state) : state(state) {}
+
+	// Arena's vector storage requires T to be copyable,
+	// but blocks never reallocate so live nodes are never copied.
+	SharedNode(SharedNode const &other) : state(other.state)
+	{
+		tot_tries = other.tot_tries.load();
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			children[i] = other.children[i].load();
+			tries[i] = other.tries[i].load();
+			wins[i] = other.wins[i].load();
+		}
+	}
+
+	Game state;
+
+	// each thread allocates from its own arena, so expansion never locks.
+	// a node that lost an expansion race was never published,
+	// so it is kept and reused by the thread's next expansion.
+	struct MyArena
+	{
+		Arena<SharedNode> arena;
+		SharedNode *spare = nullptr;
+
+		SharedNode *alloc(Game &&state)
+		{
+			if (spare == nullptr) {
+				return arena.alloc(std::move(state));
+			}
+			SharedNode *node = spare;
+			spare = nullptr;
+			node->state = state;
+			return node;
+		}
+	};
+
+	bool is_leaf() const
+	{
+		return state.winner() != NONE;
+	}
+
+	SharedNode *child(uint move) const
+	{
+		return children[move].load(std::memory_order_acquire);
+	}
+
+	// do a rollout according to the UCT exploration strategy,
+	// holding virtual_loss on every edge of the path until it returns.
+	template <typename RandomGen>
+	WinState ucb_rollout(RandomGen &rng, MyArena &arena, float virtual_loss)
+	{
+		WinState winner = state.winner();
+		if (winner != NONE) return winner;
+
+		// random_rollout updates counts
+		if (n_unplayed_moves() > 0) {
+			return random_rollout(rng, arena, virtual_loss);
+		}
+
+		uint const move = ucb_move();
+		_add_virtual_loss(move, virtual_loss);
+		winner = child(move)->ucb_rollout(rng, arena, virtual_loss);
+		_update(move, winner, virtual_loss);
+		return winner;
+	}
+
+	// add one child for a random unexplored move,
+	// then do a random playout from its state.
+	template <typename RandomGen>
+	WinState random_rollout(RandomGen &rng, MyArena &arena, float virtual_loss)
+	{
+		// other threads may have expanded our last moves meanwhile.
+		uint const move = random_unplayed_move(rng);
+		if (move == 0xFFFFFFFF) {
+			return ucb_rollout(rng, arena, virtual_loss);
+		}
+
+		// publish our child unless another thread got there first,
+		// in which case we continue below its node instead.
+		SharedNode *node = arena.alloc(state.move(move));
+		SharedNode *expected = nullptr;
+		if (!children[move].compare_exchange_strong(expected, node,
+		                                             std::memory_order_acq_rel)) {
+			arena.spare = node;
+			node = expected;
+		}
+
+		_add_virtual_loss(move, virtual_loss);
+		WinState const winner = random_playout(node->state, rng);
+		_update(move, winner, virtual_loss);
+		return winner;
+	}
+
+	// compute the number of moves that have no child yet.
+	inline uint n_unplayed_moves() const
+	{
+		uint count = 0;
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			count += (child(i) == nullptr && state.is_valid(i));
+		}
+		return count;
+	}
+
+	// find a random move that has no child yet.
+	// returns 0xFFFFFFFF if other threads expanded all of them meanwhile.
+	template <typename RandomGen>
+	uint random_unplayed_move(RandomGen &rng) const
+	{
+		uint n = n_unplayed_moves();
+		if (n == 0) return 0xFFFFFFFF;
+		std::uniform_int_distribution<uint> dist(1, n);
+		uint imove = dist(rng);
+		uint count = 0;
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			count += (child(i) == nullptr && state.is_valid(i));
+			if (count == imove) {
+				return i;
+			}
+		}
+		return 0xFFFFFFFF;
+	}
+
+	// move according to the UCB exploration strategy.
+	// edges whose first rollout has not returned yet are preferred.
+	uint ucb_move() const
+	{
+		uint player = state.player_turn();
+		float const flip = (player == 0) ? 1.0f : -1.0f;
+		float const explore = explore_term(tot_tries.load(std::memory_order_relaxed));
+
+		float ucb_max = -std::numeric_limits<float>::infinity();
+		uint i_max = 0xFFFFFFFF;
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			if (!state.is_valid(i)) continue;
+			// a move without a child has not been tried yet.
+			// this happens for the final move of a search with fewer
+			// rollouts than moves.
+			SharedNode const *c = child(i);
+			if (c == nullptr) return i;
+			// exit early if one of our children is a winning leaf state.
+			WinState const w = c->state.winner();
+			if ((player == 0 && w == WIN) || (player == 1 && w == LOSS)) {
+				return i;
+			}
+			float const n = tries[i].load(std::memory_order_relaxed);
+			if (n <= 0.0f) return i;
+			float const mean = flip * wins[i].load(std::memory_order_relaxed) / n;
+			float const ucb_i = mean + explore / sqrtf(n);
+			if (ucb_i > ucb_max) {
+				ucb_max = ucb_i;
+				i_max = i;
+			}
+		}
+		assert(i_max != 0xFFFFFFFF);
+		return i_max;
+	}
+
+	// the move to play once the search is over: a move to a winning
+	// leaf, else the most tried move with a child, as Node::best_move.
+	// moves without a child were never tried, so they are skipped.
+	uint best_move() const
+	{
+		uint const player = state.player_turn();
+		uint i_max = 0xFFFFFFFF;
+		float tries_max = 0.0f;
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			if (!state.is_valid(i)) continue;
+			SharedNode const *c = child(i);
+			if (c == nullptr) continue;
+			WinState const w = c->state.winner();
+			if ((player == 0 && w == WIN) || (player == 1 && w == LOSS)) {
+				return i;
+			}
+			float const n = tries[i].load(std::memory_order_relaxed);
+			if (i_max == 0xFFFFFFFF || n > tries_max) {
+				tries_max = n;
+				i_max = i;
+			}
+		}
+		assert(i_max != 0xFFFFFFFF);
+		return i_max;
+	}
+
+private:
+	std::atomic<float> tot_tries{0.0f};
+	std::array<std::atomic<SharedNode *>, Game::n_moves()> children = {};
+	std::array<std::atomic<float>, Game::n_moves()> tries = {};
+	std::array<std::atomic<float>, Game::n_moves()> wins = {};
+
+	// count virtual_loss losses for the player to move on this edge.
+	void _add_virtual_loss(uint move, float virtual_loss)
+	{
+		float const flip = (state.player_turn() == 0) ? 1.0f : -1.0f;
+		atomic_add(tries[move], virtual_loss);
+		atomic_add(tot_tries, virtual_loss);
+		atomic_add(wins[move], -flip * virtual_loss);
+	}
+
+	// replace the virtual loss by the real result.
+	void _update(uint move, float delta, float virtual_loss)
+	{
+		assert(delta != NONE);
+		float const flip = (state.player_turn() == 0) ? 1.0f : -1.0f;
+		atomic_add(tries[move], 1.0f - virtual_loss);
+		atomic_add(tot_tries, 1.0f - virtual_loss);
+		atomic_add(wins[move], delta + flip * virtual_loss);
+	}
+};
+
+// search from the root state with n_threads threads sharing one tree
+// and return the most tried move at its root, as root_parallel_search.
+// n_rollouts is the total budget, split evenly between the threads.
+// seeds[i] seeds the random generator of thread i.
+template <typename Game, typename RandomGen = std::default_random_engine>
+uint tree_parallel_search(uint n_threads, size_t n_rollouts,
+                          std::vector<uint> const &seeds,
+                          float virtual_loss = 1.0f, Game const &root = Game())
+{
+	assert(n_threads > 0);
+	assert(seeds.size() >= n_threads);
+
+	// nodes live in the arena of the thread that expanded them,
+	// so all arenas stay alive until the search is over.
+	std::vector<typename SharedNode<Game>::MyArena> arenas(n_threads);
+	SharedNode<Game> *tree = arenas[0].alloc(Game(root));
+	std::vector<std::thread> threads;
+	threads.reserve(n_threads);
+
+	for (uint t = 0; t < n_threads; ++t) {
+		size_t const n = n_rollouts / n_threads + (t < n_rollouts % n_threads);
+		threads.emplace_back([&, t, n]() {
+			RandomGen prng(seeds[t]);
+			for (size_t i = 0; i < n; ++i) {
+				tree->ucb_rollout(prng, arenas[t], virtual_loss);
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	return tree->best_move();
+}
+
+} // namespace mcts
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <ratio>
+
+#include "explore.hpp"
+#include "simd.hpp"
+
+/*
+Selection policies: how a tree node picks the edge to descend into
+during a rollout, once all of its moves have been tried.
+Node takes the policy as a template parameter, so it is resolved
+at compile time and there is no virtual dispatch.
+
+NOTE: this is not real Concepts code!
+
+concept SelectionPolicy
+{
+	// statistics a node keeps for the policy, besides tries and wins.
+	// empty for policies that need nothing else.
+	template <typename Game>
+	struct Stats
+	{
+		// move was taken in a rollout that ended with delta.
+		void update(uint move, float delta);
+
+		// add the statistics of another tree rooted at the same state.
+		void merge(Stats const &other);
+	};
+
+	// index of the valid move to descend into.
+	// every valid move has been tried at least once.
+	template <typename Game, typename RandomGen>
+	static uint select(Game const &state, EdgeStats const &edges,
+	                   Stats<Game> const &stats, RandomGen &rng);
+};
+
+Exploration constants are std::ratio, since floats cannot be template
+parameters. rewards are in [-1, 1] from the view of the player to move.
+*/
+
+namespace mcts
+{
+
+// a node's edge statistics, as passed to a selection policy.
+struct EdgeStats
+{
+	float const *tries;
+	float const *wins;
+	// bit i is set if move i is valid.
+	uint64_t const *valid;
+	uint n_moves;
+	float tot_tries;
+	// 1 if the player to move is player 0, else -1.
+	float flip;
+};
+
+template <typename Ratio>
+inline float constexpr ratio_value()
+{
+	return float(Ratio::num) / float(Ratio::den);
+}
+
+// for policies without statistics of their own.
+template <typename Game>
+struct NoStats
+{
+	void update(uint, float) {}
+	void merge(NoStats const &) {}
+};
+
+// mean + sqrt(C * ln(N) / n), the UCT default (Kocsis & Szepesvari, 2006).
+// vectorized, see simd.hpp.
+template <typename C = std::ratio<2>>
+struct UCB1
+{
+	template <typename Game>
+	using Stats = NoStats<Game>;
+
+	template <typename Game, typename RandomGen>
+	static uint select(Game const &, EdgeStats const &e,
+	                   Stats<Game> const &, RandomGen &)
+	{
+		// explore_term is sqrt(2 ln(N)), so scale it for C.
+		float const explore = explore_term(e.tot_tries) * std::sqrt(ratio_value<C>() / 2.0f);
+		return ucb_argmax(e.tries, e.wins, e.valid, e.n_moves, e.flip, explore);
+	}
+};
+
+// UCB1 with the exploration scaled by each move's observed variance
+// (Auer et al., "Finite-time Analysis of the Multiarmed Bandit Problem",
+// 2002). moves whose results vary little are explored less.
+struct UCB1Tuned
+{
+	template <typename Game>
+	struct Stats
+	{
+		// sum of the squared results of each move.
+		std::array<float, Game::n_moves()> squares = {};
+
+		void update(uint move, float delta)
+		{
+			squares[move] += delta * delta;
+		}
+
+		void merge(Stats const &other)
+		{
+			for (uint i = 0; i < Game::n_moves(); ++i) {
+				squares[i] += other.squares[i];
+			}
+		}
+	};
+
+	template <typename Game, typename RandomGen>
+	static uint select(Game const &, EdgeStats const &e,
+	                   Stats<Game> const &stats, RandomGen &)
+	{
+		float const explore = explore_term(e.tot_tries);
+		float const log_tot = 0.5f * explore * explore;
+
+		float ucb_max = -std::numeric_limits<float>::infinity();
+		uint i_max = 0xFFFFFFFF;
+		for (uint i = 0; i < e.n_moves; ++i) {
+			if (!mask_bit(e.valid, i)) continue;
+			float const n = e.tries[i];
+			float const mean = e.wins[i] / n;
+			float const variance = stats.squares[i] / n - mean * mean;
+			// the paper's bound of 1/4 is for results in [0, 1].
+			// ours span twice that, so it is scaled back by 2 below.
+			float const v = std::min(0.25f, 0.25f * variance + explore / sqrtf(n));
+			float const ucb_i = e.flip * mean + 2.0f * sqrtf(log_tot / n * v);
+			if (ucb_i > ucb_max) {
+				ucb_max = ucb_i;
+				i_max = i;
+			}
+		}
+		return i_max;
+	}
+};
+
+// prior probability of move for PUCT. games may provide their own
+// with a `float prior(uint move) const` method, else it is uniform.
+template <typename Game>
+auto move_prior(Game const &state, uint move, int) -> decltype(state.prior(move))
+{
+	return state.prior(move);
+}
+
+template <typename Game>
+float move_prior(Game const &state, uint, long)
+{
+	return 1.0f / state.n_valid_moves();
+}
+
+// mean + C * prior * sqrt(N) / (1 + n), the rule of AlphaZero
+// (Silver et al., 2017). strong priors focus the search early on.
+template <typename C = std::ratio<5, 4>>
+struct PUCT
+{
+	template <typename Game>
+	using Stats = NoStats<Game>;
+
+	template <typename Game, typename RandomGen>
+	static uint select(Game const &state, EdgeStats const &e,
+	                   Stats<Game> const &, RandomGen &)
+	{
+		float const explore = ratio_value<C>() * sqrtf(e.tot_tries);
+
+		float ucb_max = -std::numeric_limits<float>::infinity();
+		uint i_max = 0xFFFFFFFF;
+		for (uint i = 0; i < e.n_moves; ++i) {
+			if (!mask_bit(e.valid, i)) continue;
+			float const n = e.tries[i];
+			float const ucb_i = e.flip * e.wins[i] / n
+				+ explore * move_prior(state, i, 0) / (1.0f + n);
+			if (ucb_i > ucb_max) {
+				ucb_max = ucb_i;
+				i_max = i;
+			}
+		}
+		return i_max;
+	}
+};
+
+// sample each move's win rate from its Beta posterior and take the best
+// (Thompson, 1933). a tie counts as half a win.
+// randomized, and slower per selection than the UCB rules.
+struct Thompson
+{
+	template <typename Game>
+	using Stats = NoStats<Game>;
+
+	template <typename Game, typename RandomGen>
+	static uint select(Game const &, EdgeStats const &e,
+	                   Stats<Game> const &, RandomGen &rng)
+	{
+		float sample_max = -1.0f;
+		uint i_max = 0xFFFFFFFF;
+		for (uint i = 0; i < e.n_moves; ++i) {
+			if (!mask_bit(e.valid, i)) continue;
+			float const n = e.tries[i];
+			float const won = 0.5f * (n + e.flip * e.wins[i]);
+			// Beta(a, b) is X / (X + Y) for X ~ Gamma(a), Y ~ Gamma(b).
+			float const x = std::gamma_distribution<float>(won + 1.0f)(rng);
+			float const y = std::gamma_distribution<float>(n - won + 1.0f)(rng);
+			float const sample = x / (x + y);
+			if (sample > sample_max) {
+				sample_max = sample;
+				i_max = i;
+			}
+		}
+		return i_max;
+	}
+};
+
+} // namespace mcts
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "fastlog.hpp"
+
+// UCB selection over packed edge statistics.
+//
+// tries[i] and wins[i] are the statistics of edge i, stored as separate
+// float arrays. bit i of the valid mask is set for the edges to consider,
+// and every one of them must have tries[i] > 0.
+// explore is the node's exploration term sqrt(2 * ln(tot_tries)),
+// see explore.hpp. returns the index of the first edge with the highest
+// UCB value:
+//   flip * wins[i] / tries[i] + explore / sqrt(tries[i]).
+//
+// ucb_argmax uses the widest instruction set the compiler targets
+// (AVX-512, AVX2, or scalar code). lanes outside the valid mask are
+// never loaded, so the arrays need no padding.
+// the vector kernels take r = fast_rsqrt_v(tries) and evaluate
+//   flip * wins * r * r + explore * r
+// which needs no division or square root per edge. the UCB values are
+// within about 1e-6 relative error, so near-ties may resolve differently
+// than in ucb_argmax_scalar.
+
+namespace mcts
+{
+
+using uint = unsigned int;
+
+// move masks: bit i is set for move i, in words of 64 moves.
+
+inline bool mask_bit(uint64_t const *mask, uint i)
+{
+	return (mask[i / 64] >> (i % 64)) & 1;
+}
+
+inline uint popcount(uint64_t x)
+{
+#if defined(__POPCNT__)
+	return uint(__builtin_popcountll(x));
+#else
+	// the builtin would be a library call.
+	x = x - ((x >> 1) & 0x5555555555555555ull);
+	x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return uint((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+// index of the k-th lowest set bit of x, counting from 0. x must have
+// more than k bits set. one pdep with BMI2, else k steps.
+inline uint select_bit(uint64_t x, uint k)
+{
+#if defined(__BMI2__)
+	return uint(__builtin_ctzll(_pdep_u64(uint64_t(1) << k, x)));
+#else
+	for (uint i = 0; i < k; ++i) {
+		x &= x - 1;
+	}
+	return uint(__builtin_ctzll(x));
+#endif
+}
+
+inline uint ucb_argmax_scalar(float const *tries, float const *wins,
+                              uint64_t const *valid, uint n,
+                              float flip, float explore)
+{
+	float ucb_max = -std::numeric_limits<float>::infinity();
+	uint i_max = 0xFFFFFFFF;
+	for (uint i = 0; i < n; ++i) {
+		if (!mask_bit(valid, i)) continue;
+		float const ucb_i = flip * wins[i] / tries[i] + explore / sqrtf(tries[i]);
+		if (ucb_i > ucb_max) {
+			ucb_max = ucb_i;
+			i_max = i;
+		}
+	}
+	return i_max;
+}
+
+#if defined(__AVX512F__)
+
+inline uint ucb_argmax(float const *tries, float const *wins,
+                       uint64_t const *valid, uint n,
+                       float flip, float explore)
+{
+	__m512 const vflip = _mm512_set1_ps(flip);
+	__m512 const vexplore = _mm512_set1_ps(explore);
+	__m512 const ninf = _mm512_set1_ps(-std::numeric_limits<float>::infinity());
+	__m512i const lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+	                                       8, 9, 10, 11, 12, 13, 14, 15);
+	__m512 vmax = ninf;
+	__m512i vidx = _mm512_set1_epi32(-1);
+
+	for (uint i = 0; i < n; i += 16) {
+		__mmask16 const m = __mmask16(valid[i / 64] >> (i % 64));
+		__m512 const t = _mm512_maskz_loadu_ps(m, tries + i);
+		__m512 const w = _mm512_maskz_loadu_ps(m, wins + i);
+		__m512 const r = fast_rsqrt_v(t);
+		__m512 const mean = _mm512_mul_ps(_mm512_mul_ps(vflip, w), _mm512_mul_ps(r, r));
+		__m512 const u = _mm512_mask_mov_ps(ninf, m, _mm512_fmadd_ps(vexplore, r, mean));
+		// strictly greater, so each lane keeps its first maximum.
+		__mmask16 const gt = _mm512_cmp_ps_mask(u, vmax, _CMP_GT_OQ);
+		vmax = _mm512_mask_mov_ps(vmax, gt, u);
+		vidx = _mm512_mask_mov_epi32(vidx, gt,
+			_mm512_add_epi32(lane, _mm512_set1_epi32(int(i))));
+	}
+
+	// the first edge among the lanes holding the maximum.
+	float const best = _mm512_reduce_max_ps(vmax);
+	__mmask16 const at_best = _mm512_cmp_ps_mask(vmax, _mm512_set1_ps(best), _CMP_EQ_OQ);
+	return _mm512_mask_reduce_min_epu32(at_best, vidx);
+}
+
+#elif defined(__AVX2__)
+
+inline uint ucb_argmax(float const *tries, float const *wins,
+                       uint64_t const *valid, uint n,
+                       float flip, float explore)
+{
+	__m256 const vflip = _mm256_set1_ps(flip);
+	__m256 const vexplore = _mm256_set1_ps(explore);
+	__m256 const ninf = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+	__m256i const lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i const lane_bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256 vmax = ninf;
+	__m256i vidx = _mm256_set1_epi32(-1);
+
+	for (uint i = 0; i < n; i += 8) {
+		// spread the 8 mask bits over the 8 lanes.
+		int const bits = int((valid[i / 64] >> (i % 64)) & 0xFF);
+		__m256i const m = _mm256_cmpeq_epi32(
+			_mm256_and_si256(_mm256_set1_epi32(bits), lane_bit), lane_bit);
+		__m256 const t = _mm256_maskload_ps(tries + i, m);
+		__m256 const w = _mm256_maskload_ps(wins + i, m);
+		__m256 const r = fast_rsqrt_v(t);
+		__m256 const mean = _mm256_mul_ps(_mm256_mul_ps(vflip, w), _mm256_mul_ps(r, r));
+		__m256 const u = _mm256_blendv_ps(ninf, _mm256_add_ps(mean, _mm256_mul_ps(vexplore, r)),
+		                                  _mm256_castsi256_ps(m));
+		// strictly greater, so each lane keeps its first maximum.
+		__m256 const gt = _mm256_cmp_ps(u, vmax, _CMP_GT_OQ);
+		vmax = _mm256_blendv_ps(vmax, u, gt);
+		vidx = _mm256_castps_si256(_mm256_blendv_ps(
+			_mm256_castsi256_ps(vidx),
+			_mm256_castsi256_ps(_mm256_add_epi32(lane, _mm256_set1_epi32(int(i)))),
+			gt));
+	}
+
+	// the first edge among the lanes holding the maximum.
+	__m256 best = _mm256_max_ps(vmax, _mm256_permute2f128_ps(vmax, vmax, 1));
+	best = _mm256_max_ps(best, _mm256_shuffle_ps(best, best, 0x4E));
+	best = _mm256_max_ps(best, _mm256_shuffle_ps(best, best, 0xB1));
+	__m256i idx = _mm256_blendv_epi8(_mm256_set1_epi32(-1), vidx,
+		_mm256_castps_si256(_mm256_cmp_ps(vmax, best, _CMP_EQ_OQ)));
+	idx = _mm256_min_epu32(idx, _mm256_permute2x128_si256(idx, idx, 1));
+	idx = _mm256_min_epu32(idx, _mm256_shuffle_epi32(idx, 0x4E));
+	idx = _mm256_min_epu32(idx, _mm256_shuffle_epi32(idx, 0xB1));
+	return uint(_mm256_cvtsi256_si32(idx));
+}
+
+#else
+
+inline uint ucb_argmax(float const *tries, float const *wins,
+                       uint64_t const *valid, uint n,
+                       float flip, float explore)
+{
+	return ucb_argmax_scalar(tries, wins, valid, n, flip, explore);
+}
+
+#endif
+
+} // namespace mcts
@@ -0,0 +1,491 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <forward_list>
+#include <limits>
+#include <vector>
+
+#include "arena.hpp"
+#include "mcts.hpp"
+
+/*
+Tree node whose edges are stored sparsely.
+
+Node keeps children, tries and wins in arrays of Game::n_moves() entries,
+so every node pays for the whole move space. SparseNode instead allocates
+one contiguous run of edges, one per valid move, the first time one of its
+moves is expanded. Most nodes of a tree are leaves that are never expanded,
+and they carry no edges at all. Memory per node scales with the number of
+legal moves rather than with the global move space, which matters for games
+like Go (361 moves) or chess move encodings (thousands).
+
+SparseNode has the same interface as Node with PointerLinks,
+so it works with search(), promote() and play_vs_random().
+*/
+
+namespace mcts
+{
+
+// arena for runs of edges of any length up to NBlock.
+// freed runs are kept on a free list per length and reused first.
+// like Arena, reset() keeps the blocks and the free lists' capacity,
+// so a warmed-up EdgeArena does not call the system allocator.
+template <typename Edge, uint NBlock = 1 << 14>
+class EdgeArena
+{
+public:
+	// n value-initialized edges, contiguous in memory.
+	Edge *alloc(uint n)
+	{
+		assert(0 < n && n <= NBlock);
+		if (n < free_runs.size() && !free_runs[n].empty()) {
+			Edge *run = free_runs[n].back();
+			free_runs[n].pop_back();
+			std::fill(run, run + n, Edge());
+			n_used += n;
+			return run;
+		}
+		if (blocks.empty() || blocks.front().size() + n > NBlock) {
+			_next_block();
+		}
+		// capacity is reserved, so growing never moves earlier runs.
+		std::vector<Edge> &block = blocks.front();
+		block.resize(block.size() + n);
+		n_used += n;
+		return &block[block.size() - n];
+	}
+
+	void free(Edge *run, uint n)
+	{
+		if (free_runs.size() <= n) {
+			free_runs.resize(n + 1);
+		}
+		free_runs[n].push_back(run);
+		n_used -= n;
+	}
+
+	// forget all runs but keep the blocks for reuse.
+	void reset()
+	{
+		for (std::vector<Edge> &block : blocks) {
+			block.clear();
+		}
+		free_blocks.splice_after(free_blocks.before_begin(), blocks);
+		for (std::vector<Edge *> &runs : free_runs) {
+			runs.clear();
+		}
+		n_used = 0;
+	}
+
+	// number of live edges.
+	size_t size() const
+	{
+		return n_used;
+	}
+
+private:
+	std::forward_list<std::vector<Edge>> blocks;
+	std::forward_list<std::vector<Edge>> free_blocks;
+	std::vector<std::vector<Edge *>> free_runs;
+	size_t n_used = 0;
+
+	// splicing moves list nodes, so reusing a block allocates nothing.
+	void _next_block()
+	{
+		if (free_blocks.empty()) {
+			blocks.emplace_front();
+			blocks.front().reserve(NBlock);
+		} else {
+			blocks.splice_after(blocks.before_begin(),
+			                    free_blocks, free_blocks.before_begin());
+		}
+	}
+};
+
+template <typename Game>
+class SparseNode
+{
+public:
+	SparseNode(Game &&state) : state(state) {}
+	Game state;
+
+	struct Edge
+	{
+		SparseNode *child;
+		float tries;
+		float wins;
+		uint move;
+	};
+
+	// nodes and edge runs come from separate arenas.
+	struct MyArena
+	{
+		using value_type = SparseNode;
+
+		Arena<SparseNode> nodes;
+		EdgeArena<Edge> edges;
+
+		SparseNode *alloc(Game &&state)
+		{
+			return nodes.alloc(std::move(state));
+		}
+
+		// also frees the node's edges.
+		void free(SparseNode *node)
+		{
+			if (node->edges != nullptr) {
+				edges.free(node->edges, node->n_edges);
+			}
+			nodes.free(node);
+		}
+
+		void reset()
+		{
+			nodes.reset();
+			edges.reset();
+		}
+
+		// memory in use, in units of sizeof(SparseNode),
+		// so that MemoryBudget also accounts for the edges.
+		size_t size() const
+		{
+			return nodes.size() + (edges.size() * sizeof(Edge)
+			                       + sizeof(SparseNode) - 1) / sizeof(SparseNode);
+		}
+	};
+
+	// copy the subtree from arena `from` into arena `to`.
+	SparseNode *clone(MyArena const &from, MyArena &to) const
+	{
+		SparseNode *node = to.alloc(Game(state));
+		*node = *this;
+		if (edges != nullptr) {
+			node->edges = to.edges.alloc(n_edges);
+			for (uint e = 0; e < n_edges; ++e) {
+				node->edges[e] = edges[e];
+				if (edges[e].child != nullptr) {
+					node->edges[e].child = edges[e].child->clone(from, to);
+				}
+			}
+		}
+		return node;
+	}
+
+	bool is_leaf() const
+	{
+		return state.winner() != NONE;
+	}
+
+	// sparse nodes do not back up proven values, so only terminal
+	// nodes count as solved.
+	bool is_solved() const
+	{
+		return is_leaf();
+	}
+
+	bool is_move_explored(uint move) const
+	{
+		return child(move) != nullptr;
+	}
+
+	SparseNode *child(uint move) const
+	{
+		Edge const *e = _find(move);
+		return e == nullptr ? nullptr : e->child;
+	}
+
+	SparseNode *child(uint move, MyArena const &) const
+	{
+		return child(move);
+	}
+
+	// allocate the child node for an unexplored move.
+	SparseNode *expand(uint move, MyArena &arena)
+	{
+		_alloc_edges(arena);
+		Edge *e = _find(move);
+		assert(e != nullptr && e->child == nullptr);
+		e->child = arena.alloc(state.move(move));
+		return e->child;
+	}
+
+	// free the subtree below move and give its nodes back to the arena.
+	// the edge statistics are kept, and the child is expanded again
+	// when the move is selected later.
+	void prune(uint move, MyArena &arena)
+	{
+		_prune(_find(move), arena);
+	}
+
+	// prune the least-visited subtrees below this node
+	// until the arena holds at most max_nodes nodes.
+	void prune_least_visited(MyArena &arena, size_t max_nodes)
+	{
+		struct Item { Edge *edge; uint depth; };
+		std::vector<Item> edges_below;
+		std::vector<Item> stack = {{nullptr, 0}};
+		while (!stack.empty()) {
+			Item const item = stack.back();
+			stack.pop_back();
+			SparseNode const *node = item.edge ? item.edge->child : this;
+			for (uint e = 0; e < node->n_edges; ++e) {
+				if (node->edges[e].child != nullptr) {
+					edges_below.push_back({&node->edges[e], item.depth});
+					stack.push_back({&node->edges[e], item.depth + 1});
+				}
+			}
+		}
+		// deeper first among ties, as in Node::prune_least_visited.
+		std::sort(edges_below.begin(), edges_below.end(), [](Item const &a, Item const &b) {
+			return a.edge->tries < b.edge->tries
+				|| (a.edge->tries == b.edge->tries && a.depth > b.depth);
+		});
+		for (Item const &item : edges_below) {
+			if (arena.size() <= max_nodes) break;
+			_prune(item.edge, arena);
+		}
+	}
+
+	// do a rollout according to the UCT exploration strategy.
+	// same as Node::ucb_rollout, but walks edge runs instead of move arrays.
+	template <typename RandomGen>
+	WinState ucb_rollout(RandomGen &rng, MyArena &arena,
+	                     size_t max_nodes = std::numeric_limits<size_t>::max())
+	{
+		std::array<Edge *, Game::max_depth()> path;
+		uint depth = 0;
+
+		// continue with a playout below the edge,
+		// adding its child to the tree if the budget allows.
+		auto leaf_playout = [&](SparseNode const *node, Edge *e) {
+			Game next = node->state.move(e->move);
+			if (arena.size() < max_nodes) {
+				e->child = arena.alloc(std::move(next));
+				return random_playout(e->child->state, rng);
+			}
+			return random_playout(next, rng);
+		};
+
+		SparseNode *node = this;
+		WinState winner;
+		while ((winner = node->state.winner()) == NONE) {
+			assert(depth < path.size());
+			// a leaf of the tree gets its edges only if the budget allows,
+			// else the playout starts from it.
+			if (node->edges == nullptr && arena.size() >= max_nodes) {
+				winner = random_playout(node->state, rng);
+				break;
+			}
+			node->_alloc_edges(arena);
+			if (node->n_unplayed_moves() > 0) {
+				Edge *e = node->_random_unplayed_edge(rng);
+				path[depth++] = e;
+				winner = leaf_playout(node, e);
+				break;
+			}
+			Edge *e = node->edges + node->_ucb_edge();
+			path[depth++] = e;
+			// the move was played before, but its subtree was pruned
+			// or never added because of the memory budget.
+			if (e->child == nullptr) {
+				winner = leaf_playout(node, e);
+				break;
+			}
+			node = e->child;
+		}
+
+		// edge statistics live in the run, but the parents' totals
+		// are needed too, so walk down again from this node.
+		node = this;
+		for (uint i = 0; i < depth; ++i) {
+			++node->tot_tries;
+			++path[i]->tries;
+			path[i]->wins += winner;
+			node = path[i]->child;
+		}
+		return winner;
+	}
+
+	// compute the number of moves that have not been explored yet.
+	uint n_unplayed_moves() const
+	{
+		if (edges == nullptr) return state.n_valid_moves();
+		uint count = 0;
+		for (uint e = 0; e < n_edges; ++e) {
+			count += (edges[e].tries == 0);
+		}
+		return count;
+	}
+
+	template <typename RandomGen>
+	uint random_move(RandomGen &rng) const
+	{
+		return mcts::random_move(state, rng);
+	}
+
+	// move according to the UCB exploration strategy.
+	uint ucb_move() const
+	{
+		return edges[_ucb_edge()].move;
+	}
+
+	uint ucb_move(MyArena const &) const
+	{
+		return ucb_move();
+	}
+
+	// SparseNode always selects by UCB1.
+	template <typename RandomGen>
+	uint select_move(RandomGen &, MyArena const &) const
+	{
+		return ucb_move();
+	}
+
+	// the move to play if the search stopped now: a winning move,
+	// else the most tried one.
+	uint best_move(MyArena const &) const
+	{
+		if (edges == nullptr) {
+			for (uint i = 0; i < Game::n_moves(); ++i) {
+				if (state.is_valid(i)) return i;
+			}
+			assert(false);
+		}
+		return edges[_best_edge()].move;
+	}
+
+	// whether search can stop with n_left rollouts to go, by rule.
+	// sparse nodes only prove terminal states, see is_solved().
+	bool is_decided(size_t n_left, EarlyStop const &rule) const
+	{
+		if (edges == nullptr) return is_solved();
+		uint const best = _best_edge();
+		float const flip = (state.player_turn() == 0) ? 1.0f : -1.0f;
+		Edge const &b = edges[best];
+		bool ahead = true, better = true;
+		for (uint e = 0; e < n_edges; ++e) {
+			if (e == best) continue;
+			if (edges[e].tries > b.tries) return false;
+			ahead = ahead && rule.is_ahead(b.tries, edges[e].tries, n_left);
+			better = better && rule.is_better(flip * b.wins, b.tries,
+			                                  flip * edges[e].wins, edges[e].tries);
+		}
+		return ahead || better;
+	}
+
+private:
+	Edge *edges = nullptr;
+	uint n_edges = 0;
+	float tot_tries = 0.0f;
+
+	Edge *_find(uint move) const
+	{
+		for (uint e = 0; e < n_edges; ++e) {
+			if (edges[e].move == move) return &edges[e];
+		}
+		return nullptr;
+	}
+
+	// one edge per valid move, on first expansion.
+	void _alloc_edges(MyArena &arena)
+	{
+		if (edges != nullptr) return;
+		n_edges = state.n_valid_moves();
+		edges = arena.edges.alloc(n_edges);
+		uint e = 0;
+		for (uint i = 0; i < Game::n_moves(); ++i) {
+			if (state.is_valid(i)) {
+				edges[e++].move = i;
+			}
+		}
+		assert(e == n_edges);
+	}
+
+	// iterative, as Node::_prune.
+	void _prune(Edge *e, MyArena &arena)
+	{
+		assert(e != nullptr && e->child != nullptr);
+		std::vector<SparseNode *> stack = {e->child};
+		e->child = nullptr;
+		while (!stack.empty()) {
+			SparseNode *node = stack.back();
+			stack.pop_back();
+			for (uint i = 0; i < node->n_edges; ++i) {
+				if (node->edges[i].child != nullptr) {
+					stack.push_back(node->edges[i].child);
+				}
+			}
+			// also frees the node's edges.
+			arena.free(node);
+		}
+	}
+
+	template <typename RandomGen>
+	Edge *_random_unplayed_edge(RandomGen &rng)
+	{
+		uint n = n_unplayed_moves();
+		assert(n > 0);
+		std::uniform_int_distribution<uint> dist(1, n);
+		uint imove = dist(rng);
+		uint count = 0;
+		for (uint e = 0; e < n_edges; ++e) {
+			count += (edges[e].tries == 0);
+			if (count == imove) {
+				return &edges[e];
+			}
+		}
+		assert(false);
+		return nullptr;
+	}
+
+	uint _best_edge() const
+	{
+		uint player = state.player_turn();
+		uint e_max = 0;
+		for (uint e = 0; e < n_edges; ++e) {
+			Edge const &edge = edges[e];
+			if (edge.child != nullptr) {
+				WinState const w = edge.child->state.winner();
+				if ((player == 0 && w == WIN) || (player == 1 && w == LOSS)) {
+					return e;
+				}
+			}
+			if (edge.tries > edges[e_max].tries) e_max = e;
+		}
+		return e_max;
+	}
+
+	uint _ucb_edge() const
+	{
+		assert(edges != nullptr && n_unplayed_moves() == 0);
+
+		uint player = state.player_turn();
+		float const flip = (player == 0) ? 1.0f : -1.0f;
+		float const explore = explore_term(tot_tries);
+
+		float ucb_max = -std::numeric_limits<float>::infinity();
+		uint e_max = 0xFFFFFFFF;
+		for (uint e = 0; e < n_edges; ++e) {
+			Edge const &edge = edges[e];
+			// exit early if one of our children is a winning leaf state.
+			if (edge.child != nullptr) {
+				WinState const w = edge.child->state.winner();
+				if ((player == 0 && w == WIN) || (player == 1 && w == LOSS)) {
+					return e;
+				}
+			}
+			float const ucb_e = flip * edge.wins / edge.tries
+				+ explore / sqrtf(edge.tries);
+			if (ucb_e > ucb_max) {
+				ucb_max = ucb_e;
+				e_max = e;
+			}
+		}
+		assert(e_max != 0xFFFFFFFF);
+		return e_max;
+	}
+};
+
+} // namespace mcts
@@ -1,3 +1,5 @@
+#include <cstdint>
+
 #include "mcts.hpp"
 
 // Tic Tac Toe example game for Monte Carlo Tree Search.
@@ -9,15 +11,63 @@ static inline uint bitcount(uint v)
 {
 	v = v - ((v >> 1) & 0x55555555);
 	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-	return ((v + (v >> 4) & 0xF0F0F0F) * 0x1010101) >> 24;
+	return (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
 }
 
+// lookup tables indexed by a 9-bit board of one player,
+// generated at compile time.
+struct TicTacToeTables
+{
+	// bit b is set if board b holds a line of three.
+	uint64_t wins[512 / 64] = {};
+	// Zobrist hash of board b for each player: the xor of one random
+	// key per occupied square, with keys generated by splitmix64.
+	uint64_t zobrist[2][512] = {};
+
+	constexpr TicTacToeTables()
+	{
+		int const lines[8] = {
+			0b000'000'111, 0b000'111'000, 0b111'000'000,
+			0b001'001'001, 0b010'010'010, 0b100'100'100,
+			0b100'010'001, 0b001'010'100,
+		};
+		uint64_t keys[2][9] = {};
+		uint64_t x = 0x9E3779B97F4A7C15ull;
+		for (int p = 0; p < 2; ++p) {
+			for (int i = 0; i < 9; ++i) {
+				x += 0x9E3779B97F4A7C15ull;
+				uint64_t z = x;
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+				keys[p][i] = z ^ (z >> 31);
+			}
+		}
+		for (int b = 0; b < 512; ++b) {
+			for (int line : lines) {
+				if ((b & line) == line) {
+					wins[b / 64] |= uint64_t(1) << (b % 64);
+				}
+			}
+			for (int i = 0; i < 9; ++i) {
+				if (b & (1 << i)) {
+					zobrist[0][b] ^= keys[0][i];
+					zobrist[1][b] ^= keys[1][i];
+				}
+			}
+		}
+	}
+};
+
+static constexpr TicTacToeTables tictactoe_tables;
+
 class TicTacToe
 {
 public:
 	static uint constexpr n_moves() { return 9; }
+	static uint constexpr max_depth() { return 9; }
 
-	uint player_turn() const { return iplayer; }
+	// X moves first, so it is O's turn when X has one more mark.
+	uint player_turn() const { return bitcount(xos[0] | xos[1]) & 1; }
 
 	mcts::WinState winner() const
 	{
@@ -39,32 +89,36 @@ public:
 		return (pos & (xos[0] | xos[1])) == 0;
 	}
 
+	uint64_t valid_moves_mask() const
+	{
+		return ~(xos[0] | xos[1]) & 0x1FF;
+	}
+
 	TicTacToe move(uint mv) const
 	{
 		TicTacToe t = *this;
-		t.xos[iplayer] |= (1 << mv);
-		t.iplayer = (iplayer + 1) & 1;
+		t.xos[player_turn()] |= (1 << mv);
 		return t;
 	}
 
+	// Zobrist hash: the xor of the keys of the occupied squares.
+	// each board's share is looked up rather than kept in the state,
+	// which would triple its size.
+	uint64_t hash() const
+	{
+		return tictactoe_tables.zobrist[0][xos[0]] ^ tictactoe_tables.zobrist[1][xos[1]];
+	}
+
 	friend std::ostream &operator<<(std::ostream &s, TicTacToe const &ttt);
 
 private:
-	static bool is_win(int state)
+	static bool is_win(uint board)
 	{
-		static int winning_states[] = {
-			0b000'000'111, 0b000'111'000, 0b111'000'000,
-			0b001'001'001, 0b010'010'010, 0b100'100'100,
-			0b100'010'001, 0b001'010'100,
-		};
-		for (int s : winning_states) {
-			if ((s & state) == s) return true;
-		}
-		return false;
+		return (tictactoe_tables.wins[board / 64] >> (board % 64)) & 1;
 	}
 
-	uint xos[2] = {0, 0};
-	int iplayer = 0;
+	// 9-bit boards of X and O. the whole state is 4 bytes.
+	uint16_t xos[2] = {0, 0};
 };
 
 std::ostream &operator<<(std::ostream &s, TicTacToe const &ttt)
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "mcts.hpp"
+
+/*
+Transposition table: nodes keyed by the hash of their game state, so
+that different move orders reaching the same state share one node.
+The search tree becomes a DAG, and the statistics of a state are no
+longer split between copies of its subtree.
+
+Node needs no changes for this: TranspositionArena wraps a node arena,
+and its alloc() returns the node already stored for the state if there
+is one. Node::expand() then links to that node instead of a new one.
+Edge statistics stay in the parents, so each parent keeps its own tries
+and wins, while a shared node counts the visits from all of its parents
+(the "UCT1" update of Childs et al., "Transpositions and Move Groups in
+Monte Carlo Tree Search", CIG 2008).
+
+The game must provide hash(), and no state may be reachable from itself.
+*/
+
+namespace mcts
+{
+
+// the finalizer of splitmix64. Game::hash() need not be well mixed,
+// e.g. a packed board is fine, since the table mixes it.
+inline uint64_t mix_hash(uint64_t h)
+{
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+	return h ^ (h >> 31);
+}
+
+// fixed-size open-addressing hash table from state hashes to nodes,
+// with linear probing. it only grows: entries are never removed,
+// only all at once by clear().
+// find() and insert() are lock-free and can be called from several
+// threads at once. a slot is claimed by a compare-and-swap on its node,
+// and then its key is published; a reader that sees the node before
+// the key compares the node's own hash instead.
+// states with equal 64-bit hashes are taken to be equal.
+template <typename T>
+class TranspositionTable
+{
+public:
+	explicit TranspositionTable(uint log2_size = 20)
+		: mask((size_t(1) << log2_size) - 1), slots(mask + 1)
+	{
+	}
+
+	// moving is not thread-safe.
+	TranspositionTable(TranspositionTable &&other)
+		: mask(other.mask), slots(std::move(other.slots)), n_entries(other.n_entries.load())
+	{
+	}
+
+	TranspositionTable &operator=(TranspositionTable &&other)
+	{
+		std::swap(mask, other.mask);
+		std::swap(slots, other.slots);
+		n_entries.store(other.n_entries.exchange(n_entries.load()));
+		return *this;
+	}
+
+	// the node stored for a state with hash h, or nullptr.
+	T *find(uint64_t h) const
+	{
+		uint64_t const key = mix_hash(h);
+		for (uint i = 0; i < MAX_PROBES; ++i) {
+			Slot const &slot = slots[(key + i) & mask];
+			T *node = slot.node.load(std::memory_order_acquire);
+			if (node == nullptr) return nullptr;
+			if (_matches(slot, node, key)) return node;
+		}
+		return nullptr;
+	}
+
+	// store node for hash h, unless a node for h is stored already.
+	// returns the stored node, which is node itself if it was inserted.
+	// if all probed slots hold other states, nothing is stored and
+	// nullptr is returned.
+	T *insert(uint64_t h, T *node)
+	{
+		uint64_t const key = mix_hash(h);
+		for (uint i = 0; i < MAX_PROBES; ++i) {
+			Slot &slot = slots[(key + i) & mask];
+			T *expected = nullptr;
+			if (slot.node.compare_exchange_strong(expected, node, std::memory_order_acq_rel)) {
+				slot.key.store(key, std::memory_order_release);
+				n_entries.fetch_add(1, std::memory_order_relaxed);
+				return node;
+			}
+			if (_matches(slot, expected, key)) return expected;
+		}
+		return nullptr;
+	}
+
+	// remove all entries. not thread-safe.
+	void clear()
+	{
+		for (Slot &slot : slots) {
+			slot.node.store(nullptr, std::memory_order_relaxed);
+			slot.key.store(0, std::memory_order_relaxed);
+		}
+		n_entries.store(0, std::memory_order_relaxed);
+	}
+
+	size_t size() const
+	{
+		return n_entries.load(std::memory_order_relaxed);
+	}
+
+	size_t capacity() const
+	{
+		return slots.size();
+	}
+
+private:
+	// a full stretch of this many slots counts as a full table.
+	static uint constexpr MAX_PROBES = 32;
+
+	struct Slot
+	{
+		std::atomic<T *> node{nullptr};
+		// mixed hash of the node's state, 0 until published.
+		std::atomic<uint64_t> key{0};
+	};
+
+	size_t mask;
+	std::vector<Slot> slots;
+	std::atomic<size_t> n_entries{0};
+
+	static bool _matches(Slot const &slot, T const *node, uint64_t key)
+	{
+		uint64_t const k = slot.key.load(std::memory_order_acquire);
+		if (k != 0) return k == key;
+		return mix_hash(node->state.hash()) == key;
+	}
+};
+
+// node arena that stores at most one node per game state.
+// can replace the arena of a search: alloc() returns the node already
+// stored for the state if there is one, else a new node.
+//
+// nodes can be shared by several parents, so single nodes cannot be
+// freed: there is no free(), and a search with OnBudget::PRUNE does not
+// compile. cloning a subtree, as promote() does, keeps the sharing.
+template <typename NodeArena>
+class TranspositionArena
+{
+public:
+	using value_type = typename NodeArena::value_type;
+
+	// see mcts::shares_nodes.
+	static bool constexpr shares_nodes = true;
+
+	// the table has 2^log2_table_size slots of 16 bytes. once it is
+	// full, new states get nodes of their own without an entry.
+	explicit TranspositionArena(uint log2_table_size = 20)
+		: table(log2_table_size)
+	{
+	}
+
+	TranspositionArena(TranspositionArena &&) = default;
+	TranspositionArena &operator=(TranspositionArena &&) = default;
+
+	template <typename Game>
+	value_type *alloc(Game &&state)
+	{
+		uint64_t const h = state.hash();
+		if (value_type *node = table.find(h)) {
+			++n_transpositions;
+			return node;
+		}
+		value_type *node = nodes.alloc(std::forward<Game>(state));
+		table.insert(h, node);
+		return node;
+	}
+
+	// number of distinct nodes.
+	size_t size() const
+	{
+		return nodes.size();
+	}
+
+	void reset()
+	{
+		nodes.reset();
+		table.clear();
+		n_transpositions = 0;
+	}
+
+	// number of alloc() calls answered with an existing node.
+	size_t transpositions() const
+	{
+		return n_transpositions;
+	}
+
+	// for IndexLinks, if NodeArena numbers its nodes.
+	value_type *at(uint32_t i) const
+	{
+		return nodes.at(i);
+	}
+
+	uint32_t index_of(value_type const *p) const
+	{
+		return nodes.index_of(p);
+	}
+
+private:
+	NodeArena nodes;
+	TranspositionTable<value_type> table;
+	size_t n_transpositions = 0;
+};
+
+} // namespace mcts